@@ -7,6 +7,8 @@
 
 #include "terrain.h"
 #include "generator.h"
+#include "math.h"
+#include "trace.h"
 
 #include <algorithm>
 
@@ -69,6 +71,20 @@ namespace
 		return result;
 	}
 
+	// the prototypes are loaded only once and shared by all planets
+	const std::vector<Doodad> &doodadsCatalog()
+	{
+		static const std::vector<Doodad> catalog = []() {
+			const string root = pathSearchTowardsRoot("doodads", PathTypeFlags::Directory);
+			std::vector<Doodad> doodads = loadDoodads(root, root);
+			// the order of files in directories is not guaranteed
+			std::sort(doodads.begin(), doodads.end(), [](const Doodad &a, const Doodad &b) { return a.proto < b.proto; });
+			CAGE_LOG(SeverityEnum::Info, "doodads", stringizer() + "found " + doodads.size() + " doodad prototypes");
+			return doodads;
+		}();
+		return catalog;
+	}
+
 	real factorInRange(const vec2 &range, real value)
 	{
 		const real m = (range[0] + range[1]) * 0.5;
@@ -77,7 +93,7 @@ namespace
 		return max(0, v);
 	}
 
-	const Doodad *chooseDoodad(const std::vector<Doodad> &doodads, const Tile &tile)
+	const Doodad *chooseDoodad(const std::vector<Doodad> &doodads, const Tile &tile, RandomGenerator &rng)
 	{
 		struct Eligible
 		{
@@ -122,7 +138,7 @@ namespace
 			e.prob *= probMult;
 
 		for (const Eligible &e : eligible)
-			if (randomChance() < e.prob)
+			if (rng.randomChance() < e.prob)
 				return e.doodad;
 
 		return nullptr;
@@ -161,18 +177,18 @@ namespace
 void generateDoodads(const Holder<Mesh> &navMesh, const std::vector<Tile> &tiles, std::vector<string> &assetPackages, const string &doodadsPath, const string &statsLogPath)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", "generating doodads");
+	TraceScope trace("doodads");
 
 	CAGE_ASSERT(navMesh->verticesCount() == tiles.size());
 
-	const string root = pathSearchTowardsRoot("doodads", PathTypeFlags::Directory);
-	const std::vector<Doodad> doodads = loadDoodads(root, root);
-	CAGE_LOG(SeverityEnum::Info, "doodads", stringizer() + "found " + doodads.size() + " doodad prototypes");
+	std::vector<Doodad> doodads = doodadsCatalog(); // copy to count the instances for this planet
 
+	RandomGenerator rng = seededRandom("doodads");
 	Holder<File> f = writeFile(doodadsPath);
 	for (const auto &it : enumerate(navMesh->positions()))
 	{
 		const uint32 i = numeric_cast<uint32>(it.index);
-		const Doodad *doodad = chooseDoodad(doodads, tiles[i]);
+		const Doodad *doodad = chooseDoodad(doodads, tiles[i], rng);
 		if (!doodad)
 			continue;
 		assetPackages.push_back(doodad->package);
@@ -1,4 +1,5 @@
 #include <cage-core/concurrent.h>
+#include <cage-core/concurrentQueue.h>
 #include <cage-core/tasks.h>
 #include <cage-core/files.h>
 #include <cage-core/config.h>
@@ -12,9 +13,13 @@
 #include "terrain.h"
 #include "generator.h"
 #include "mesh.h"
+#include "math.h"
+#include "trace.h"
+#include "voronoi.h"
 
 #include <atomic>
 #include <chrono>
+#include <exception>
 #include <ctime>
 
 namespace
@@ -57,12 +62,13 @@ namespace
 		return pathToAbs(pathJoin("tmp", stringizer() + currentProcessId()));
 	}
 
-	const string planetName = generateName();
+	string planetName;
 	const string baseDirectory = findTmpDirectory();
 	const string assetsDirectory = pathJoin(baseDirectory, "data");
 	const string debugDirectory = pathJoin(baseDirectory, "intermediate");
 	ConfigString configShapeMode("unnatural-planets/shape/mode");
 	ConfigBool configDebugSaveIntermediate("unnatural-planets/debug/saveIntermediate");
+	ConfigBool configDebugBenchmark("unnatural-planets/debug/benchmark");
 	ConfigBool configPreviewEnable("unnatural-planets/preview/enable");
 	std::vector<string> assetPackages;
 	struct Chunk
@@ -71,6 +77,7 @@ namespace
 		string material;
 		string albedo, special, heightmap;
 		bool transparency = false;
+		bool normalMap = false; // the heightmap is a normal map already
 	};
 	std::vector<Chunk> chunks;
 	Holder<Mutex> chunksMutex = newMutex();
@@ -92,6 +99,7 @@ namespace
 				std::strftime(buffer, 50, "%Y-%m-%d %H:%M:%S", std::localtime(&now));
 				f->writeLine(stringizer() + "date: " + buffer);
 			}
+			f->writeLine(stringizer() + "seed: " + planetSeed());
 #ifdef CAGE_DEBUG
 			f->writeLine("generated with DEBUG build");
 #endif // CAGE_DEBUG
@@ -147,7 +155,12 @@ namespace
 			f->writeLine("scheme = texture");
 			f->writeLine("convert = heightToNormal");
 			for (const Chunk &c : chunks)
-				if (!c.heightmap.empty())
+				if (!c.heightmap.empty() && !c.normalMap)
+					f->writeLine(c.heightmap);
+			f->writeLine("[]");
+			f->writeLine("scheme = texture");
+			for (const Chunk &c : chunks)
+				if (!c.heightmap.empty() && c.normalMap)
 					f->writeLine(c.heightmap);
 			for (const Chunk &c : chunks)
 			{
@@ -179,7 +192,7 @@ namespace
 import os
 import bpy
 
-def loadChunk(meshname, objname, albedoname, specialname, heightname, transparency):
+def loadChunk(meshname, objname, albedoname, specialname, heightname, transparency, normalmap):
 	bpy.ops.import_scene.obj(filepath = meshname)
 	bpy.ops.image.open(filepath = os.getcwd() + '/' + albedoname)
 	bpy.ops.image.open(filepath = os.getcwd() + '/' + specialname)
@@ -203,18 +216,23 @@ def loadChunk(meshname, objname, albedoname, specialname, heightname, transparen
 	heightMap = nodes.new('ShaderNodeTexImage')
 	heightMap.image = bpy.data.images[heightname]
 	heightMap.image.colorspace_settings.name = 'Non-Color'
-	bump = nodes.new('ShaderNodeBump')
-	bump.inputs['Strength'].default_value = 2
-	bump.inputs['Distance'].default_value = 5
-	links.new(heightMap.outputs['Color'], bump.inputs['Height'])
-	links.new(bump.outputs['Normal'], shader.inputs['Normal'])
+	if normalmap:
+		normal = nodes.new('ShaderNodeNormalMap')
+		links.new(heightMap.outputs['Color'], normal.inputs['Color'])
+		links.new(normal.outputs['Normal'], shader.inputs['Normal'])
+	else:
+		bump = nodes.new('ShaderNodeBump')
+		bump.inputs['Strength'].default_value = 2
+		bump.inputs['Distance'].default_value = 5
+		links.new(heightMap.outputs['Color'], bump.inputs['Height'])
+		links.new(bump.outputs['Normal'], shader.inputs['Normal'])
 	bpy.data.objects[objname].material_slots[0].material = mat
 
 )Python");
 			for (const Chunk &c : chunks)
 			{
 				f->writeLine(stringizer() + "loadChunk('" + c.mesh + "', '" + replace(c.mesh, ".obj", "") + "', '"
-					+ c.albedo + "', '" + c.special + "', '" + c.heightmap + "', " + (c.transparency ? "True" : "False") + ")");
+					+ c.albedo + "', '" + c.special + "', '" + c.heightmap + "', " + (c.transparency ? "True" : "False") + ", " + (c.normalMap ? "True" : "False") + ")");
 			}
 			f->write(R"Python(
 for a in bpy.data.window_managers[0].windows[0].screen.areas:
@@ -230,13 +248,173 @@ bpy.ops.object.select_all(action='DESELECT')
 		}
 	}
 
+	// finished meshes and textures are written by dedicated threads, so that the tasks can proceed with the next chunk
+	struct Exporter : private Immovable
+	{
+		struct Job
+		{
+			string path; // empty to stop the writer
+			Holder<Mesh> mesh;
+			Holder<Image> image;
+			std::vector<char> encoded; // whole file content, already compressed
+			bool transparency = false;
+			TextureUsageEnum usage = TextureUsageEnum::Albedo;
+		};
+
+		static constexpr uint32 WritersCount = 2;
+		static constexpr uint32 QueueCapacity = 8; // limits memory held by pending jobs
+
+		ConcurrentQueue<Job> queue = ConcurrentQueue<Job>(QueueCapacity);
+		Holder<Thread> writers[WritersCount];
+		Holder<Mutex> failureMutex = newMutex();
+		std::exception_ptr failure; // the first exception thrown in a writer
+
+		void rethrowFailure()
+		{
+			std::exception_ptr f;
+			{
+				ScopeLock lock(failureMutex);
+				f = failure;
+			}
+			if (f)
+				std::rethrow_exception(f);
+		}
+
+		// the producers see the failure of the writer instead of the terminated queue
+		void push(Job &&job)
+		{
+			try
+			{
+				queue.push(std::move(job));
+			}
+			catch (const ConcurrentQueueTerminated &)
+			{
+				rethrowFailure();
+				throw;
+			}
+		}
+
+		void writerEntry()
+		{
+			try
+			{
+				while (true)
+				{
+					Job job;
+					queue.pop(job);
+					if (job.path.empty())
+						break;
+					if (job.mesh)
+						meshSaveRender(job.path, job.mesh, job.transparency);
+					else if (!job.encoded.empty())
+					{
+						TraceScope trace("dds export");
+						Holder<File> f = writeFile(job.path);
+						f->write({ job.encoded.data(), job.encoded.data() + job.encoded.size() });
+						f->close();
+					}
+					else
+					{
+						CAGE_ASSERT(pathExtractExtension(job.path) != ".dds"); // the writers must not use the tasks pool
+						textureSave(job.path, job.image, job.usage);
+					}
+				}
+			}
+			catch (const ConcurrentQueueTerminated &)
+			{
+				// nothing
+			}
+			catch (...)
+			{
+				{
+					ScopeLock lock(failureMutex);
+					if (!failure)
+						failure = std::current_exception();
+				}
+				queue.terminate(); // unblocks the producers, they rethrow the stored exception
+				throw;
+			}
+		}
+
+		Exporter()
+		{
+			for (uint32 i = 0; i < WritersCount; i++)
+				writers[i] = newThread(Delegate<void()>().bind<Exporter, &Exporter::writerEntry>(this), stringizer() + "exporter " + i);
+		}
+
+		~Exporter()
+		{
+			// abandons pending jobs when the generation failed
+			queue.terminate();
+			for (auto &w : writers)
+			{
+				try
+				{
+					if (w)
+						w->wait();
+				}
+				catch (...)
+				{
+					// nothing
+				}
+			}
+		}
+
+		void mesh(const string &path, Holder<Mesh> &&mesh, bool transparency)
+		{
+			Job job;
+			job.path = path;
+			job.mesh = std::move(mesh);
+			job.transparency = transparency;
+			push(std::move(job));
+		}
+
+		void texture(const string &path, Holder<Image> &&image, TextureUsageEnum usage)
+		{
+			Job job;
+			job.path = path;
+			// the block compression uses the tasks pool, which must not be waited for in the writers
+			// the producers may block the pool workers on the full queue, so the writers would never proceed
+			if (pathExtractExtension(path) == ".dds")
+				job.encoded = textureEncodeDds(image, usage);
+			else
+				job.image = std::move(image);
+			job.usage = usage;
+			push(std::move(job));
+		}
+
+		// one stop job per writer, queued after all other jobs
+		void finish()
+		{
+			try
+			{
+				for (uint32 i = 0; i < WritersCount; i++)
+					queue.push(Job());
+			}
+			catch (const ConcurrentQueueTerminated &)
+			{
+				// a writer has failed
+			}
+			for (auto &w : writers)
+			{
+				w->wait();
+				w.clear();
+			}
+			rethrowFailure();
+		}
+	};
+
 	struct NavmeshProcessor
 	{
+		const TerrainContext *context = nullptr;
+		Holder<MeshDensities> densities;
 		Holder<detail::AsyncTask> taskRef;
 
 		void processEntry(uint32)
 		{
-			Holder<Mesh> base = meshGenerateBaseNavigation();
+			TraceScope trace("navigation processor");
+			Holder<Mesh> base = meshGenerateBaseNavigation(+densities);
+			densities.clear();
 			if (configDebugSaveIntermediate)
 				meshSaveDebug(pathJoin(debugDirectory, "navMeshBase.obj"), base);
 			{
@@ -244,7 +422,7 @@ bpy.ops.object.select_all(action='DESELECT')
 				meshSimplifyNavmesh(navmesh);
 				CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "navmesh tiles: " + navmesh->verticesCount());
 				std::vector<Tile> tiles;
-				generateTileProperties(navmesh, tiles, pathJoin(baseDirectory, "tileStats.log"));
+				generateTileProperties(context, navmesh, tiles, pathJoin(baseDirectory, "tileStats.log"));
 				meshSaveNavigation(pathJoin(assetsDirectory, "navmesh.obj"), navmesh, tiles);
 				generateDoodads(navmesh, tiles, assetPackages, pathJoin(baseDirectory, "doodads.ini"), pathJoin(baseDirectory, "doodadStats.log"));
 			}
@@ -255,7 +433,7 @@ bpy.ops.object.select_all(action='DESELECT')
 			}
 		}
 
-		NavmeshProcessor()
+		NavmeshProcessor(const TerrainContext *context, Holder<MeshDensities> &&densities) : context(context), densities(std::move(densities))
 		{
 			taskRef = tasksRunAsync(Delegate<void(uint32)>().bind<NavmeshProcessor, &NavmeshProcessor::processEntry>(this), 1, 15);
 		}
@@ -268,26 +446,30 @@ bpy.ops.object.select_all(action='DESELECT')
 
 	struct LandProcessor
 	{
+		const TerrainContext *context = nullptr;
+		Exporter *exporter = nullptr;
+		Holder<MeshDensities> densities;
 		std::vector<Holder<Mesh>> split;
 
 		Holder<detail::AsyncTask> taskRef;
 
 		void chunkEntry(uint32 index)
 		{
+			TraceScope trace(stringizer() + "land chunk " + index);
 			Chunk c;
 			c.mesh = stringizer() + "land-" + index + ".obj";
 			c.material = stringizer() + "land-" + index + ".cpm";
-			c.albedo = stringizer() + "land-" + index + "-albedo.png";
-			c.special = stringizer() + "land-" + index + "-special.png";
-			c.heightmap = stringizer() + "land-" + index + "-height.png";
-			const auto &msh = split[index];
-			const uint32 resolution = meshUnwrap(msh);
-			meshSaveRender(pathJoin(assetsDirectory, c.mesh), msh, c.transparency);
+			c.albedo = stringizer() + "land-" + index + "-albedo" + textureExtension();
+			c.special = stringizer() + "land-" + index + "-special" + textureExtension();
+			c.normalMap = textureNormalMap();
+			c.heightmap = stringizer() + "land-" + index + (c.normalMap ? "-normal" : "-height") + textureExtension();
+			const uint32 resolution = meshUnwrap(split[index]);
 			Holder<Image> albedo, special, heightMap;
-			generateTexturesLand(msh, resolution, resolution, albedo, special, heightMap);
-			albedo->exportFile(pathJoin(assetsDirectory, c.albedo));
-			special->exportFile(pathJoin(assetsDirectory, c.special));
-			heightMap->exportFile(pathJoin(assetsDirectory, c.heightmap));
+			generateTexturesLand(context, split[index], resolution, resolution, albedo, special, heightMap);
+			exporter->mesh(pathJoin(assetsDirectory, c.mesh), std::move(split[index]), c.transparency);
+			exporter->texture(pathJoin(assetsDirectory, c.albedo), std::move(albedo), TextureUsageEnum::Albedo);
+			exporter->texture(pathJoin(assetsDirectory, c.special), std::move(special), TextureUsageEnum::Special);
+			exporter->texture(pathJoin(assetsDirectory, c.heightmap), std::move(heightMap), c.normalMap ? TextureUsageEnum::Normal : TextureUsageEnum::Height);
 			{
 				ScopeLock lock(chunksMutex);
 				chunks.push_back(c);
@@ -296,8 +478,10 @@ bpy.ops.object.select_all(action='DESELECT')
 
 		void processEntry(uint32)
 		{
+			TraceScope trace("land processor");
 			{
-				Holder<Mesh> mesh = meshGenerateBaseLand();
+				Holder<Mesh> mesh = meshGenerateBaseLand(+densities);
+				densities.clear();
 				if (configDebugSaveIntermediate)
 					meshSaveDebug(pathJoin(debugDirectory, "landMeshBase.obj"), mesh);
 				meshSimplifyRender(mesh);
@@ -309,7 +493,7 @@ bpy.ops.object.select_all(action='DESELECT')
 			tasksRun(Delegate<void(uint32)>().bind<LandProcessor, &LandProcessor::chunkEntry>(this), numeric_cast<uint32>(split.size()));
 		}
 
-		LandProcessor()
+		LandProcessor(const TerrainContext *context, Exporter *exporter, Holder<MeshDensities> &&densities) : context(context), exporter(exporter), densities(std::move(densities))
 		{
 			taskRef = tasksRunAsync(Delegate<void(uint32)>().bind<LandProcessor, &LandProcessor::processEntry>(this), 1, 20);
 		}
@@ -322,27 +506,31 @@ bpy.ops.object.select_all(action='DESELECT')
 
 	struct WaterProcessor
 	{
+		const TerrainContext *context = nullptr;
+		Exporter *exporter = nullptr;
+		Holder<MeshDensities> densities;
 		std::vector<Holder<Mesh>> split;
 
 		Holder<detail::AsyncTask> taskRef;
 
 		void chunkEntry(uint32 index)
 		{
+			TraceScope trace(stringizer() + "water chunk " + index);
 			Chunk c;
 			c.mesh = stringizer() + "water-" + index + ".obj";
 			c.material = stringizer() + "water-" + index + ".cpm";
-			c.albedo = stringizer() + "water-" + index + "-albedo.png";
-			c.special = stringizer() + "water-" + index + "-special.png";
-			c.heightmap = stringizer() + "water-" + index + "-height.png";
+			c.albedo = stringizer() + "water-" + index + "-albedo" + textureExtension();
+			c.special = stringizer() + "water-" + index + "-special" + textureExtension();
+			c.normalMap = textureNormalMap();
+			c.heightmap = stringizer() + "water-" + index + (c.normalMap ? "-normal" : "-height") + textureExtension();
 			c.transparency = true;
-			const auto &msh = split[index];
-			const uint32 resolution = meshUnwrap(msh);
-			meshSaveRender(pathJoin(assetsDirectory, c.mesh), msh, c.transparency);
+			const uint32 resolution = meshUnwrap(split[index]);
 			Holder<Image> albedo, special, heightMap;
-			generateTexturesWater(msh, resolution, resolution, albedo, special, heightMap);
-			albedo->exportFile(pathJoin(assetsDirectory, c.albedo));
-			special->exportFile(pathJoin(assetsDirectory, c.special));
-			heightMap->exportFile(pathJoin(assetsDirectory, c.heightmap));
+			generateTexturesWater(context, split[index], resolution, resolution, albedo, special, heightMap);
+			exporter->mesh(pathJoin(assetsDirectory, c.mesh), std::move(split[index]), c.transparency);
+			exporter->texture(pathJoin(assetsDirectory, c.albedo), std::move(albedo), TextureUsageEnum::Albedo);
+			exporter->texture(pathJoin(assetsDirectory, c.special), std::move(special), TextureUsageEnum::Special);
+			exporter->texture(pathJoin(assetsDirectory, c.heightmap), std::move(heightMap), c.normalMap ? TextureUsageEnum::Normal : TextureUsageEnum::Height);
 			{
 				ScopeLock lock(chunksMutex);
 				chunks.push_back(c);
@@ -351,8 +539,10 @@ bpy.ops.object.select_all(action='DESELECT')
 
 		void processEntry(uint32)
 		{
+			TraceScope trace("water processor");
 			{
-				Holder<Mesh> mesh = meshGenerateBaseWater();
+				Holder<Mesh> mesh = meshGenerateBaseWater(+densities);
+				densities.clear();
 				if (mesh->indicesCount() == 0)
 				{
 					CAGE_LOG(SeverityEnum::Info, "generator", "generated no water");
@@ -369,7 +559,7 @@ bpy.ops.object.select_all(action='DESELECT')
 			tasksRun(Delegate<void(uint32)>().bind<WaterProcessor, &WaterProcessor::chunkEntry>(this), numeric_cast<uint32>(split.size()));
 		}
 
-		WaterProcessor()
+		WaterProcessor(const TerrainContext *context, Exporter *exporter, Holder<MeshDensities> &&densities) : context(context), exporter(exporter), densities(std::move(densities))
 		{
 			taskRef = tasksRunAsync(Delegate<void(uint32)>().bind<WaterProcessor, &WaterProcessor::processEntry>(this), 1, 10);
 		}
@@ -383,18 +573,34 @@ bpy.ops.object.select_all(action='DESELECT')
 
 void generateEntry()
 {
+	// reset state from previous planet
+	assetPackages.clear();
+	chunks.clear();
+	if (pathType(baseDirectory) != PathTypeFlags::NotFound)
+		pathRemove(baseDirectory);
+
+	planetName = generateName();
 	CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "planet name: '" + planetName + "'");
 	CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "tmp directory: " + baseDirectory);
 
-	terrainPreseed();
-
 	{
-		NavmeshProcessor navigation;
-		LandProcessor land;
-		WaterProcessor water;
+		TraceScope trace("generate");
+		Holder<TerrainContext> context = newTerrainContext();
+		if (configDebugBenchmark)
+		{
+			TraceScope trace("benchmark");
+			terrainSdfBenchmark(+context);
+			voronoiBenchmark();
+		}
+		Exporter exporter;
+		Holder<MeshDensities> densities = meshGenerateDensities(+context);
+		NavmeshProcessor navigation(+context, densities.share());
+		LandProcessor land(+context, &exporter, densities.share());
+		WaterProcessor water(+context, &exporter, std::move(densities));
 		navigation.wait();
 		land.wait();
 		water.wait();
+		exporter.finish();
 	}
 
 	exportConfiguration();
@@ -402,6 +608,7 @@ void generateEntry()
 	const string outDirectory = findOutputDirectory(planetName);
 	CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "output directory: " + outDirectory);
 	pathMove(baseDirectory, outDirectory);
+	traceExport(pathJoin(outDirectory, "trace.json"));
 
 	if (configPreviewEnable)
 	{
@@ -8,11 +8,25 @@
 using namespace cage;
 
 struct Tile;
+class TerrainContext;
 
-void generateTileProperties(const Holder<Mesh> &navMesh, std::vector<Tile> &tiles, const string &statsLogPath);
+void generateTileProperties(const TerrainContext *context, const Holder<Mesh> &navMesh, std::vector<Tile> &tiles, const string &statsLogPath);
 void generateDoodads(const Holder<Mesh> &navMesh, const std::vector<Tile> &tiles, std::vector<string> &assetPackages, const string &doodadsPath, const string &statsLogPath);
-void generateTexturesLand(const Holder<Mesh> &renderMesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap);
-void generateTexturesWater(const Holder<Mesh> &renderMesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap);
+// the height map is replaced with a tangent-space normal map when textureNormalMap is enabled
+void generateTexturesLand(const TerrainContext *context, const Holder<Mesh> &renderMesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap);
+void generateTexturesWater(const TerrainContext *context, const Holder<Mesh> &renderMesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap);
+enum class TextureUsageEnum : uint8
+{
+	Albedo, // srgb
+	Special,
+	Height,
+	Normal,
+};
+
+bool textureNormalMap();
+string textureExtension(); // including the dot, according to the configured format
+std::vector<char> textureEncodeDds(const Holder<Image> &image, TextureUsageEnum usage); // whole file content, the blocks are compressed in the tasks pool
+void textureSave(const string &path, const Holder<Image> &image, TextureUsageEnum usage); // dds uses the tasks pool too
 void generateEntry();
 string generateName();
 
@@ -5,24 +5,113 @@
 
 #include "terrain.h"
 #include "generator.h"
+#include "math.h"
 
 namespace
 {
+	struct QualityPreset
+	{
+		const char *name;
+		uint32 meshResolution; // samples along each axis of the full box
+		uint32 meshIterations;
+		float tileSize; // navigation mesh edge length
+		float texelsPerUnit;
+	};
+
+	constexpr QualityPreset qualityPresets[] = {
+		{ "draft", 70, 1, 30, 0.3f },
+		{ "normal", 300, 10, 10, 2.5f },
+		{ "high", 400, 15, 7, 4 },
+		{ "ultra", 500, 20, 5, 6 },
+	};
+
+	void applyQuality(const Holder<Ini> &cmd)
+	{
+#ifdef CAGE_DEBUG
+		constexpr const char *qualityInit = "draft";
+#else
+		constexpr const char *qualityInit = "normal";
+#endif // CAGE_DEBUG
+		ConfigString configQuality("unnatural-planets/quality/preset", qualityInit);
+		configQuality = cmd->cmdString('q', "quality", configQuality);
+		configQuality = toLower((string)configQuality);
+
+		const QualityPreset *preset = nullptr;
+		for (const QualityPreset &q : qualityPresets)
+			if ((string)configQuality == q.name)
+				preset = &q;
+		if (!preset)
+		{
+			CAGE_LOG_THROW(stringizer() + "quality preset: '" + (string)configQuality + "'");
+			CAGE_THROW_ERROR(Exception, "unknown quality preset");
+		}
+
+		// the preset only provides defaults, individual variables set explicitly take precedence
+		const ConfigUint32 configMeshResolution("unnatural-planets/mesh/resolution", preset->meshResolution);
+		const ConfigUint32 configMeshIterations("unnatural-planets/mesh/iterations", preset->meshIterations);
+		const ConfigFloat configMeshTileSize("unnatural-planets/mesh/tileSize", preset->tileSize);
+		const ConfigFloat configTexelsPerUnit("unnatural-planets/texture/texelsPerUnit", preset->texelsPerUnit);
+		if (configMeshResolution < 16 || configMeshIterations == 0 || configMeshTileSize <= 0 || configTexelsPerUnit <= 0)
+			CAGE_THROW_ERROR(Exception, "invalid quality configuration");
+
+		// rough estimate relative to the normal preset, dominated by the voxels and the texels
+		const QualityPreset &normal = qualityPresets[1];
+		const real voxels = pow(real(configMeshResolution) / normal.meshResolution, 3);
+		const real texels = sqr(real(configTexelsPerUnit) / normal.texelsPerUnit);
+		const real simplify = real(configMeshIterations) / normal.meshIterations;
+		const real cost = voxels * 0.5 + texels * 0.35 + simplify * 0.15;
+
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "quality preset: '" + (string)configQuality + "'");
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "mesh resolution: " + (uint32)configMeshResolution + ", iterations: " + (uint32)configMeshIterations + ", tile size: " + (float)configMeshTileSize + ", texels per unit: " + (float)configTexelsPerUnit);
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "estimated cost: " + cost + " times the normal preset");
+	}
+
+	// the configuration as requested, before the random choices are resolved for individual planets
+	string requestedSeed;
+	string requestedShapeMode;
+	bool requestedPoles = false;
+
+	void applySeed(const Holder<Ini> &cmd)
+	{
+		ConfigString configSeed("unnatural-planets/seed", "random");
+		configSeed = cmd->cmdString('n', "seed", configSeed);
+		requestedSeed = configSeed;
+		if (requestedSeed != "random" && (!isDigitsOnly(requestedSeed) || requestedSeed.empty()))
+		{
+			CAGE_LOG_THROW(stringizer() + "seed: '" + requestedSeed + "'");
+			CAGE_THROW_ERROR(Exception, "invalid seed configuration");
+		}
+	}
+
 	void applyConfiguration(const Holder<Ini> &cmd)
 	{
+		applySeed(cmd);
+		applyQuality(cmd);
+
 		ConfigString configShapeMode("unnatural-planets/shape/mode", "random");
 		configShapeMode = cmd->cmdString('s', "shape", configShapeMode);
 		configShapeMode = toLower((string)configShapeMode);
+		requestedShapeMode = configShapeMode;
 
 		ConfigString configElevationMode("unnatural-planets/elevation/mode", "lakes");
 		configElevationMode = cmd->cmdString('e', "elevation", configElevationMode);
 		configElevationMode = toLower((string)configElevationMode);
 
-		terrainApplyConfig();
+		// the default depends on the shape of each planet, unless the poles were configured (eg. in an ini file) or passed on the command line
+		const bool polesConfigured = configGetType("unnatural-planets/poles/enable") != ConfigTypeEnum::Undefined;
+		const bool polesPassed = cmd->sectionExists("p") || cmd->sectionExists("poles");
+		requestedPoles = polesConfigured || polesPassed;
+		if (polesPassed)
+		{
+			ConfigBool configPolesEnable("unnatural-planets/poles/enable", false);
+			configPolesEnable = cmd->cmdBool('p', "poles", configPolesEnable);
+		}
 
-		ConfigBool configPolesEnable("unnatural-planets/poles/enable", (string)configShapeMode == "sphere");
-		configPolesEnable = cmd->cmdBool('p', "poles", configPolesEnable);
-		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "enable poles: " + !!configPolesEnable);
+		ConfigUint32 configPlanetsCount("unnatural-planets/batch/count", 1);
+		configPlanetsCount = cmd->cmdUint32('c', "count", configPlanetsCount);
+		if (configPlanetsCount == 0)
+			CAGE_THROW_ERROR(Exception, "invalid planets count configuration");
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "planets count: " + (uint32)configPlanetsCount);
 
 #ifdef CAGE_DEBUG
 		constexpr bool navmeshOptimizeInit = false;
@@ -33,14 +122,63 @@ namespace
 		configNavmeshOptimize = cmd->cmdBool('o', "optimize", configNavmeshOptimize);
 		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "enable navmesh optimizations: " + !!configNavmeshOptimize);
 		
+		ConfigString configTextureFormat("unnatural-planets/texture/format", "png");
+		configTextureFormat = cmd->cmdString('f', "format", configTextureFormat);
+		configTextureFormat = toLower((string)configTextureFormat);
+		if ((string)configTextureFormat != "png" && (string)configTextureFormat != "dds")
+		{
+			CAGE_LOG_THROW(stringizer() + "texture format: '" + (string)configTextureFormat + "'");
+			CAGE_THROW_ERROR(Exception, "unknown texture format");
+		}
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "texture format: " + (string)configTextureFormat);
+
+		// the height maps would be converted to normal maps from the lossy blocks in the asset processor, so dds requires the normal maps generated here
+		const bool dds = (string)configTextureFormat == "dds";
+		ConfigBool configTextureNormalMap("unnatural-planets/texture/normalMap", dds);
+		configTextureNormalMap = cmd->cmdBool('m', "normalMap", configTextureNormalMap);
+		if (dds && !configTextureNormalMap)
+			CAGE_THROW_ERROR(Exception, "dds texture format requires normal maps");
+		ConfigFloat configTextureNormalStrength("unnatural-planets/texture/normalStrength", 1);
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "generate normal maps: " + !!configTextureNormalMap + ", strength: " + (float)configTextureNormalStrength);
+
 		ConfigBool configDebugSaveIntermediate("unnatural-planets/debug/saveIntermediate", false);
 		configDebugSaveIntermediate = cmd->cmdBool('d', "debug", configDebugSaveIntermediate);
 		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "enable saving intermediates for debug: " + !!configDebugSaveIntermediate);
 
+		ConfigBool configDebugBenchmark("unnatural-planets/debug/benchmark", false);
+		configDebugBenchmark = cmd->cmdBool('b', "benchmark", configDebugBenchmark);
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "enable terrain benchmark: " + !!configDebugBenchmark);
+
 		ConfigBool configPreviewEnable("unnatural-planets/preview/enable", false);
 		configPreviewEnable = cmd->cmdBool('r', "preview", configPreviewEnable);
+		if (dds && configPreviewEnable)
+			CAGE_THROW_ERROR(Exception, "preview in blender cannot open dds textures, use png texture format");
 		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "enable preview: " + !!configPreviewEnable);
 	}
+
+	// resolves the seed, the shape and the poles for one planet of the batch
+	void applyPlanetConfiguration(uint32 index)
+	{
+		ConfigString configSeed("unnatural-planets/seed");
+		ConfigString configShapeMode("unnatural-planets/shape/mode");
+		ConfigBool configPolesEnable("unnatural-planets/poles/enable");
+
+		uint64 seed;
+		if (requestedSeed == "random")
+			seed = detail::globalRandomGenerator().next();
+		else
+			seed = toUint64(requestedSeed) + index; // consecutive seeds keep the whole batch reproducible
+		planetSeed(seed);
+		configSeed = stringizer() + seed;
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "seed: " + seed);
+
+		configShapeMode = requestedShapeMode;
+		terrainApplyConfig();
+
+		if (!requestedPoles)
+			configPolesEnable = (string)configShapeMode == "sphere";
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "enable poles: " + !!configPolesEnable);
+	}
 }
 
 int main(int argc, const char *args[])
@@ -58,7 +196,14 @@ int main(int argc, const char *args[])
 			cmd->checkUnusedWithHelp();
 		}
 
-		generateEntry();
+		const uint32 count = ConfigUint32("unnatural-planets/batch/count");
+		for (uint32 index = 0; index < count; index++)
+		{
+			if (count > 1)
+				CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "generating planet " + (index + 1) + " of " + count);
+			applyPlanetConfiguration(index);
+			generateEntry();
+		}
 		return 0;
 	}
 	catch (...)
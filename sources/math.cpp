@@ -3,6 +3,8 @@
 
 #include "math.h"
 
+#include <cstring>
+
 real rescale(real v, real ia, real ib, real oa, real ob)
 {
 	return (v - ia) / (ib - ia) * (ob - oa) + oa;
@@ -35,9 +37,9 @@ real smoothMax(real a, real b, real k)
 	return -smoothMin(-a, -b, k);
 }
 
-vec3 colorDeviation(const vec3 &color, real deviation)
+vec3 colorDeviation(const vec3 &color, const vec3 &position, uint32 seed, real deviation)
 {
-	vec3 hsl = colorRgbToHsluv(color) + (randomChance3() - 0.5) * deviation;
+	vec3 hsl = colorRgbToHsluv(color) + (positionRandom3(position, seed) - 0.5) * deviation;
 	hsl[0] = (hsl[0] + 1) % 1;
 	return colorHsluvToRgb(saturate(hsl));
 }
@@ -68,8 +70,80 @@ vec3 anyPerpendicular(const vec3 &a)
 	return normalize(cross(a, b));
 }
 
-uint32 noiseSeed()
+namespace
+{
+	uint64 planetSeedValue = 0;
+	bool planetSeedInitialized = false;
+
+	uint64 splitMix(uint64 x)
+	{
+		x += 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	uint64 keyHash(const char *key)
+	{
+		// fnv-1a
+		uint64 h = 0xCBF29CE484222325ull;
+		while (*key)
+			h = (h ^ uint8(*key++)) * 0x100000001B3ull;
+		return splitMix(h ^ planetSeed());
+	}
+}
+
+void planetSeed(uint64 seed)
+{
+	planetSeedValue = seed;
+	planetSeedInitialized = true;
+}
+
+uint64 planetSeed()
+{
+	CAGE_ASSERT(planetSeedInitialized);
+	return planetSeedValue;
+}
+
+uint32 noiseSeed(const char *key)
+{
+	return uint32(keyHash(key) >> 32);
+}
+
+RandomGenerator seededRandom(const char *key)
+{
+	const uint64 h = keyHash(key);
+	return RandomGenerator(h, splitMix(h));
+}
+
+namespace
+{
+	uint32 positionHash(const vec3 &position, uint32 seed)
+	{
+		uint32 h = hash(seed);
+		for (uint32 i = 0; i < 3; i++)
+		{
+			const float v = position[i].value;
+			uint32 bits;
+			std::memcpy(&bits, &v, sizeof(bits));
+			h = hash(h ^ bits);
+		}
+		return h;
+	}
+
+	real hashToChance(uint32 h)
+	{
+		return (h >> 8) / real(1 << 24);
+	}
+}
+
+real positionRandom(const vec3 &position, uint32 seed)
+{
+	return hashToChance(positionHash(position, seed));
+}
+
+vec3 positionRandom3(const vec3 &position, uint32 seed)
 {
-	static RandomGenerator gen = detail::globalRandomGenerator();
-	return (uint32)gen.next();
+	const uint32 h = positionHash(position, seed);
+	return vec3(hashToChance(h), hashToChance(hash(h)), hashToChance(hash(hash(h))));
 }
@@ -2,6 +2,7 @@
 #define math_h_e6t4hjdr
 
 #include <cage-core/math.h>
+#include <cage-core/random.h>
 
 using namespace cage;
 
@@ -10,11 +11,20 @@ real sharpEdge(real v, real p = 0.05);
 real terrace(real x, real steepness);
 real smoothMin(real a, real b, real k);
 real smoothMax(real a, real b, real k);
-vec3 colorDeviation(const vec3 &color, real deviation = 0.05);
+vec3 colorDeviation(const vec3 &color, const vec3 &position, uint32 seed, real deviation = 0.05);
 vec3 colorHueShift(const vec3 &rgb, real shift);
 vec3 normalDeviation(const vec3 &normal, real strength);
 bool isUnit(const vec3 &v);
 vec3 anyPerpendicular(const vec3 &a);
-uint32 noiseSeed();
+
+// all randomness of the planet is derived from its seed
+void planetSeed(uint64 seed);
+uint64 planetSeed();
+uint32 noiseSeed(const char *key); // independent on the order of initialization of the noise functions
+RandomGenerator seededRandom(const char *key);
+
+// stateless random numbers in range [0, 1) derived from the position (and seed), reproducible regardless of threads or order of evaluation
+real positionRandom(const vec3 &position, uint32 seed);
+vec3 positionRandom3(const vec3 &position, uint32 seed);
 
 #endif
@@ -8,10 +8,16 @@
 using namespace cage;
 
 struct Tile;
+class TerrainContext;
 
-Holder<Mesh> meshGenerateBaseLand();
-Holder<Mesh> meshGenerateBaseWater();
-Holder<Mesh> meshGenerateBaseNavigation();
+// shape and elevation fields sampled once and shared by all base meshes
+class MeshDensities : private Immovable
+{};
+
+Holder<MeshDensities> meshGenerateDensities(const TerrainContext *context);
+Holder<Mesh> meshGenerateBaseLand(const MeshDensities *densities);
+Holder<Mesh> meshGenerateBaseWater(const MeshDensities *densities);
+Holder<Mesh> meshGenerateBaseNavigation(const MeshDensities *densities);
 std::vector<Holder<Mesh>> meshSplit(const Holder<Mesh> &mesh);
 void meshSimplifyNavmesh(Holder<Mesh> &mesh);
 void meshSimplifyCollider(Holder<Mesh> &mesh);
@@ -2,65 +2,474 @@
 #include <cage-core/config.h>
 #include <cage-core/mesh.h>
 #include <cage-core/marchingCubes.h>
+#include <cage-core/tasks.h>
 #include <unnatural-navmesh/navmesh.h>
 
 #include "terrain.h"
 #include "mesh.h"
+#include "trace.h"
 
 #include <initializer_list>
+#include <unordered_map>
 
 namespace
 {
-	constexpr real boxSize = 2500;
-#ifdef CAGE_DEBUG
-	constexpr uint32 boxResolution = 70;
-	constexpr uint32 iterations = 1;
-	constexpr float tileSize = 30;
-#else
-	constexpr uint32 boxResolution = 300;
-	constexpr uint32 iterations = 10;
-	constexpr float tileSize = 10;
-#endif // CAGE_DEBUG
+	constexpr real boxSize = terrainBoxSize;
 
 	ConfigBool configNavmeshOptimize("unnatural-planets/navmesh/optimize");
+	ConfigUint32 configMeshResolution("unnatural-planets/mesh/resolution");
+	ConfigUint32 configMeshIterations("unnatural-planets/mesh/iterations");
+	ConfigFloat configMeshTileSize("unnatural-planets/mesh/tileSize");
+	ConfigFloat configTexelsPerUnit("unnatural-planets/texture/texelsPerUnit");
 
-	template<real(*FNC)(const vec3 &)>
-	Holder<Mesh> meshGenerateGeneric()
+	constexpr uint32 brickSize = 16;
+	constexpr real lipschitzSafety = 1.5; // some shapes are only approximate distance bounds
+	constexpr uint32 brickOverlap = 3; // samples shared with neighboring bricks when meshing
+	constexpr uint32 weldResolution = 64; // per voxel
+
+	constexpr uint32 boundsResolution = 64; // cells per axis when probing the shape extent
+	constexpr uint32 boundsMargin = 2; // voxels
+
+	ConfigBool configMeshSparse("unnatural-planets/mesh/sparse", true);
+	ConfigBool configMeshTight("unnatural-planets/mesh/tight", true);
+
+	// part of the full box lattice that is actually sampled
+	struct GridLayout
+	{
+		uint32 boxResolution = configMeshResolution;
+		real voxelSize = boxSize / (boxResolution - 1);
+		uint32 offset[3] = {};
+		uint32 resolution[3] = { boxResolution, boxResolution, boxResolution };
+		uint32 bricks[3] = {};
+
+		GridLayout()
+		{
+			updateBricks();
+		}
+
+		void updateBricks()
+		{
+			for (uint32 i = 0; i < 3; i++)
+				bricks[i] = (resolution[i] + brickSize - 1) / brickSize;
+		}
+
+		uint32 bricksCount() const
+		{
+			return bricks[0] * bricks[1] * bricks[2];
+		}
+
+		uint32 brickIndex(uint32 x, uint32 y, uint32 z) const
+		{
+			return ((z / brickSize) * bricks[1] + y / brickSize) * bricks[0] + x / brickSize;
+		}
+
+		vec3 position(uint32 x, uint32 y, uint32 z) const
+		{
+			// matches the sampling positions of the marching cubes
+			return vec3(x + offset[0], y + offset[1], z + offset[2]) / (boxResolution - 1) * boxSize - boxSize * 0.5;
+		}
+	};
+
+	struct BoundsProbe
+	{
+		const TerrainContext *const context = nullptr;
+		const real cellSize = boxSize / boundsResolution;
+		const real reach = (cellSize * sqrt(3) * 0.5 + terrainSdfDisplacementBound(context)) * lipschitzSafety;
+		std::vector<std::pair<ivec3, ivec3>> slices; // min and max cell, per z slice
+
+		explicit BoundsProbe(const TerrainContext *context) : context(context)
+		{}
+
+		void sliceEntry(uint32 z)
+		{
+			ivec3 a = ivec3(boundsResolution), b = ivec3(-1);
+			real xs[boundsResolution], ys[boundsResolution], zs[boundsResolution], rs[boundsResolution];
+			for (uint32 x = 0; x < boundsResolution; x++)
+			{
+				xs[x] = (x + 0.5) * cellSize - boxSize * 0.5;
+				zs[x] = (z + 0.5) * cellSize - boxSize * 0.5;
+			}
+			for (uint32 y = 0; y < boundsResolution; y++)
+			{
+				for (uint32 x = 0; x < boundsResolution; x++)
+					ys[x] = (y + 0.5) * cellSize - boxSize * 0.5;
+				terrainSdfWater(context, { xs, xs + boundsResolution }, { ys, ys + boundsResolution }, { zs, zs + boundsResolution }, { rs, rs + boundsResolution });
+				for (uint32 x = 0; x < boundsResolution; x++)
+				{
+					// the cell may contain any of the surfaces
+					if (abs(rs[x]) > reach)
+						continue;
+					const ivec3 c = ivec3(x, y, z);
+					a = min(a, c);
+					b = max(b, c);
+				}
+			}
+			slices[z] = { a, b };
+		}
+
+		GridLayout layout()
+		{
+			slices.resize(boundsResolution);
+			tasksRun(Delegate<void(uint32)>().bind<BoundsProbe, &BoundsProbe::sliceEntry>(this), boundsResolution);
+			ivec3 a = ivec3(boundsResolution), b = ivec3(-1);
+			for (const auto &it : slices)
+			{
+				if (it.second[0] < 0)
+					continue; // empty slice
+				a = min(a, it.first);
+				b = max(b, it.second);
+			}
+			GridLayout g;
+			if (b[0] < 0)
+				return g; // no surface found, keep the full box
+			for (uint32 i = 0; i < 3; i++)
+			{
+				// snap to the lattice of the full box so that the samples stay the same
+				const real lo = a[i] * cellSize / g.voxelSize;
+				const real hi = (b[i] + 1) * cellSize / g.voxelSize;
+				const uint32 first = numeric_cast<uint32>(max(sint32(floor(lo).value) - sint32(boundsMargin), 0));
+				const uint32 last = numeric_cast<uint32>(min(sint32(ceil(hi).value) + sint32(boundsMargin), sint32(g.boxResolution - 1)));
+				g.offset[i] = first;
+				g.resolution[i] = last - first + 1;
+			}
+			g.updateBricks();
+			return g;
+		}
+	};
+
+	struct BrickRange
 	{
-		MarchingCubesCreateConfig cfg;
-		cfg.box = Aabb(vec3(boxSize * -0.5), vec3(boxSize * 0.5));
-		cfg.resolution = ivec3(boxResolution);
-		Holder<MarchingCubes> cubes = newMarchingCubes(cfg);
-		cubes->updateByPosition(Delegate<real(const vec3 &)>().bind<FNC>());
-		Holder<Mesh> poly = cubes->makeMesh();
+		uint32 a[3] = {};
+		uint32 b[3] = {};
+
+		explicit BrickRange(const GridLayout &grid, uint32 index)
+		{
+			const uint32 c[3] = { index % grid.bricks[0], (index / grid.bricks[0]) % grid.bricks[1], index / (grid.bricks[0] * grid.bricks[1]) };
+			for (uint32 i = 0; i < 3; i++)
+			{
+				a[i] = c[i] * brickSize;
+				b[i] = min(a[i] + brickSize, grid.resolution[i]);
+			}
+		}
+
+		uint32 samplesCount() const
+		{
+			return (b[0] - a[0]) * (b[1] - a[1]) * (b[2] - a[2]);
+		}
+
+		uint32 sampleIndex(uint32 x, uint32 y, uint32 z) const
+		{
+			CAGE_ASSERT(x >= a[0] && x < b[0] && y >= a[1] && y < b[1] && z >= a[2] && z < b[2]);
+			return ((z - a[2]) * (b[1] - a[1]) + y - a[1]) * (b[0] - a[0]) + x - a[0];
+		}
+	};
+
+	class MeshDensitiesImpl : public MeshDensities
+	{
+	public:
+		struct Brick
+		{
+			std::vector<real> shapes;
+			std::vector<real> elevations;
+			real constant; // shape value for all samples of a brick that cannot contain any surface
+		};
+
+		const TerrainContext *const context = nullptr;
+		GridLayout grid;
+		std::vector<Brick> bricks;
+		const real displacement = terrainSdfDisplacementBound(context);
+		const bool sparse = configMeshSparse;
+
+		void brickEntry(uint32 index)
+		{
+			const BrickRange r = BrickRange(grid, index);
+			Brick &brick = bricks[index];
+
+			if (sparse)
+			{
+				// the shape sdf bounds the distance to its surface, and the elevation moves the surface at most by the displacement
+				const vec3 a = grid.position(r.a[0], r.a[1], r.a[2]);
+				const vec3 b = grid.position(r.b[0] - 1, r.b[1] - 1, r.b[2] - 1);
+				const real reach = (distance(a, b) * 0.5 + grid.voxelSize + displacement) * lipschitzSafety;
+				const real center = terrainSdfWater(context, (a + b) * 0.5);
+				if (abs(center) > reach)
+				{
+					brick.constant = center;
+					return;
+				}
+			}
+
+			brick.shapes.resize(r.samplesCount());
+			brick.elevations.resize(r.samplesCount());
+			const uint32 w = r.b[0] - r.a[0];
+			real xs[brickSize], ys[brickSize], zs[brickSize];
+			for (uint32 x = r.a[0]; x < r.b[0]; x++)
+				xs[x - r.a[0]] = grid.position(x, 0, 0)[0];
+			uint32 offset = 0;
+			for (uint32 z = r.a[2]; z < r.b[2]; z++)
+			{
+				for (uint32 y = r.a[1]; y < r.b[1]; y++)
+				{
+					// evaluate whole rows at once
+					const vec3 pos = grid.position(0, y, z);
+					for (uint32 i = 0; i < w; i++)
+					{
+						ys[i] = pos[1];
+						zs[i] = pos[2];
+					}
+					const auto &row = [&](real *p) { return PointerRange<const real>(p, p + w); };
+					terrainSdfDensities(context, row(xs), row(ys), row(zs), { brick.shapes.data() + offset, brick.shapes.data() + offset + w }, { brick.elevations.data() + offset, brick.elevations.data() + offset + w });
+					offset += w;
+				}
+			}
+			CAGE_ASSERT(offset == r.samplesCount());
+		}
+
+		explicit MeshDensitiesImpl(const TerrainContext *context) : context(context)
+		{
+			if (configMeshTight)
+			{
+				grid = BoundsProbe(context).layout();
+				CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "density grid resolution: " + grid.resolution[0] + "x" + grid.resolution[1] + "x" + grid.resolution[2] + " (full box: " + grid.boxResolution + ")");
+			}
+			bricks.resize(grid.bricksCount());
+			tasksRun(Delegate<void(uint32)>().bind<MeshDensitiesImpl, &MeshDensitiesImpl::brickEntry>(this), numeric_cast<uint32>(bricks.size()));
+
+			uint32 sampled = 0;
+			for (const Brick &b : bricks)
+				sampled += !b.shapes.empty();
+			CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "sampled " + sampled + " out of " + bricks.size() + " density bricks");
+		}
+
+		template<real(*FNC)(real, real)>
+		real value(uint32 x, uint32 y, uint32 z) const
+		{
+			const uint32 index = grid.brickIndex(x, y, z);
+			const Brick &brick = bricks[index];
+			if (brick.shapes.empty())
+				return FNC(brick.constant, 0);
+			const uint32 i = BrickRange(grid, index).sampleIndex(x, y, z);
+			return FNC(brick.shapes[i], brick.elevations[i]);
+		}
+	};
+
+	struct MeshPiece
+	{
+		std::vector<vec3> positions;
+		std::vector<vec3> normals;
+		std::vector<uint32> indices;
+	};
+
+	// meshes every brick independently (with overlap) and stitches the pieces back together
+	template<real(*FNC)(real, real)>
+	struct MeshGenerator
+	{
+		const MeshDensitiesImpl *impl = nullptr;
+		std::vector<MeshPiece> pieces;
+
+		void brickEntry(uint32 index)
+		{
+			const GridLayout &grid = impl->grid;
+			const BrickRange r = BrickRange(grid, index);
+			uint32 a[3], b[3], res[3];
+			for (uint32 i = 0; i < 3; i++)
+			{
+				a[i] = r.a[i] > brickOverlap ? r.a[i] - brickOverlap : 0;
+				b[i] = min(r.b[i] + brickOverlap, grid.resolution[i]);
+				res[i] = b[i] - a[i];
+			}
+
+			MarchingCubesCreateConfig cfg;
+			cfg.box = Aabb(grid.position(a[0], a[1], a[2]), grid.position(b[0] - 1, b[1] - 1, b[2] - 1));
+			cfg.resolution = ivec3(res[0], res[1], res[2]);
+			Holder<MarchingCubes> cubes = newMarchingCubes(cfg);
+			{
+				const PointerRange<real> ds = cubes->densities();
+				CAGE_ASSERT(ds.size() == res[0] * res[1] * res[2]);
+				bool positive = false, negative = false;
+				real *d = ds.data();
+				for (uint32 z = a[2]; z < b[2]; z++)
+				{
+					for (uint32 y = a[1]; y < b[1]; y++)
+					{
+						for (uint32 x = a[0]; x < b[0]; x++)
+						{
+							const real v = impl->value<FNC>(x, y, z);
+							positive |= v > 0;
+							negative |= v < 0;
+							*d++ = v;
+						}
+					}
+				}
+				if (!positive || !negative)
+					return; // no surface in this brick
+			}
+
+			Holder<Mesh> poly = cubes->makeMesh();
+			meshConvertToIndexed(+poly);
+			const auto ps = poly->positions();
+			const auto ns = poly->normals();
+			const auto is = poly->indices();
+			const bool hasNormals = ns.size() == ps.size();
+			const uint32 trisCount = numeric_cast<uint32>(is.size() / 3);
+
+			// keep only triangles whose centroid is inside this brick, each of the overlapping bricks keeps its own part
+			MeshPiece &piece = pieces[index];
+			std::vector<uint32> remap;
+			remap.resize(ps.size(), m);
+			for (uint32 t = 0; t < trisCount; t++)
+			{
+				const vec3 g = ((ps[is[t * 3 + 0]] + ps[is[t * 3 + 1]] + ps[is[t * 3 + 2]]) / 3 + boxSize * 0.5) / grid.voxelSize;
+				bool owned = true;
+				for (uint32 i = 0; i < 3; i++)
+				{
+					const uint32 c = numeric_cast<uint32>(clamp(sint32(floor(g[i]).value) - sint32(grid.offset[i]), 0, sint32(grid.resolution[i] - 1))) / brickSize;
+					owned &= c == r.a[i] / brickSize;
+				}
+				if (!owned)
+					continue;
+				for (uint32 j = 0; j < 3; j++)
+				{
+					const uint32 v = is[t * 3 + j];
+					if (remap[v] == m)
+					{
+						remap[v] = numeric_cast<uint32>(piece.positions.size());
+						piece.positions.push_back(ps[v]);
+						if (hasNormals)
+							piece.normals.push_back(ns[v]);
+					}
+					piece.indices.push_back(remap[v]);
+				}
+			}
+		}
+
+		Holder<Mesh> stitch()
+		{
+			std::vector<vec3> positions;
+			std::vector<vec3> normals;
+			std::vector<uint32> indices;
+			std::unordered_map<uint64, uint32> welds;
+			const real weldDistance = impl->grid.voxelSize / weldResolution;
+			bool hasNormals = true;
+
+			const auto &key = [](const ivec3 &q) -> uint64 {
+				return (uint64(q[0] & 0x1FFFFF) << 42) | (uint64(q[1] & 0x1FFFFF) << 21) | uint64(q[2] & 0x1FFFFF);
+			};
+
+			// vertices on the seams were computed by several bricks, possibly with slightly different rounding
+			const auto &weld = [&](const vec3 &p, const vec3 &n) -> uint32 {
+				const vec3 g = (p + boxSize * 0.5) / weldDistance;
+				const ivec3 q = ivec3(floor(g));
+				ivec3 side;
+				for (uint32 i = 0; i < 3; i++)
+					side[i] = g[i] - q[i] < 0.5 ? -1 : 1;
+				for (uint32 k = 0; k < 8; k++)
+				{
+					const ivec3 c = q + ivec3(k & 1 ? side[0] : 0, k & 2 ? side[1] : 0, k & 4 ? side[2] : 0);
+					const auto it = welds.find(key(c));
+					if (it != welds.end() && distanceSquared(positions[it->second], p) <= sqr(weldDistance * 2))
+						return it->second;
+				}
+				const uint32 index = numeric_cast<uint32>(positions.size());
+				positions.push_back(p);
+				normals.push_back(n);
+				welds.emplace(key(q), index);
+				return index;
+			};
+
+			for (const MeshPiece &piece : pieces)
+			{
+				const uint32 base = numeric_cast<uint32>(indices.size());
+				hasNormals &= piece.normals.size() == piece.positions.size();
+				for (uint32 i : piece.indices)
+					indices.push_back(weld(piece.positions[i], piece.normals.empty() ? vec3() : piece.normals[i]));
+				// remove triangles collapsed by the welding
+				uint32 w = base;
+				for (uint32 t = base; t < indices.size(); t += 3)
+				{
+					const uint32 i0 = indices[t + 0], i1 = indices[t + 1], i2 = indices[t + 2];
+					if (i0 == i1 || i1 == i2 || i2 == i0)
+						continue;
+					indices[w++] = i0;
+					indices[w++] = i1;
+					indices[w++] = i2;
+				}
+				indices.resize(w);
+			}
+
+			Holder<Mesh> poly = newMesh();
+			poly->positions(positions);
+			if (hasNormals)
+				poly->normals(normals);
+			poly->indices(indices);
+			return poly;
+		}
+
+		explicit MeshGenerator(const MeshDensitiesImpl *impl) : impl(impl)
+		{
+			pieces.resize(impl->bricks.size());
+			tasksRun(Delegate<void(uint32)>().bind<MeshGenerator, &MeshGenerator::brickEntry>(this), numeric_cast<uint32>(pieces.size()));
+		}
+	};
+
+	template<real(*FNC)(real, real)>
+	Holder<Mesh> meshGenerateGeneric(const MeshDensities *densities)
+	{
+		MeshGenerator<FNC> generator((const MeshDensitiesImpl *)densities);
+		Holder<Mesh> poly = generator.stitch();
 		meshDiscardDisconnected(+poly);
 		meshFlipNormals(+poly);
 		return poly;
 	}
 }
 
-Holder<Mesh> meshGenerateBaseLand()
+Holder<MeshDensities> meshGenerateDensities(const TerrainContext *context)
+{
+	CAGE_LOG(SeverityEnum::Info, "generator", "generating base densities");
+	TraceScope trace("base densities");
+	return systemMemory().createImpl<MeshDensities, MeshDensitiesImpl>(context);
+}
+
+Holder<Mesh> meshGenerateBaseLand(const MeshDensities *densities)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", "generating base land mesh");
-	Holder<Mesh> poly = meshGenerateGeneric<&terrainSdfLand>();
+	TraceScope trace("base land mesh");
+	Holder<Mesh> poly = meshGenerateGeneric<&terrainSdfLand>(densities);
 	if (poly->indicesCount() == 0)
 		CAGE_THROW_ERROR(Exception, "generated empty base land mesh");
 	return poly;
 }
 
-Holder<Mesh> meshGenerateBaseWater()
+Holder<Mesh> meshGenerateBaseWater(const MeshDensities *densities)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", "generating base water mesh");
-	Holder<Mesh> poly = meshGenerateGeneric<&terrainSdfWater>();
+	TraceScope trace("base water mesh");
+	Holder<Mesh> poly = meshGenerateGeneric<&terrainSdfWater>(densities);
 
 	{
 		meshConvertToIndexed(+poly);
 
 		// check which vertices are needed
+		const TerrainContext *context = ((const MeshDensitiesImpl *)densities)->context;
 		std::vector<bool> valid;
-		valid.reserve(poly->verticesCount());
-		for (const vec3 &p : poly->positions())
-			valid.push_back(terrainSdfElevationRaw(p) < 0.1);
+		{
+			const uint32 cnt = poly->verticesCount();
+			std::vector<real> xs, ys, zs, elevs;
+			xs.reserve(cnt);
+			ys.reserve(cnt);
+			zs.reserve(cnt);
+			for (const vec3 &p : poly->positions())
+			{
+				xs.push_back(p[0]);
+				ys.push_back(p[1]);
+				zs.push_back(p[2]);
+			}
+			elevs.resize(cnt);
+			terrainSdfElevationRaw(context, xs, ys, zs, elevs);
+			valid.reserve(cnt);
+			for (const real e : elevs)
+				valid.push_back(e < 0.1);
+		}
 
 		// expand valid vertices to whole triangles and their neighbors
 		for (uint32 j = 0; j < 2; j++)
@@ -91,10 +500,11 @@ Holder<Mesh> meshGenerateBaseWater()
 	return poly;
 }
 
-Holder<Mesh> meshGenerateBaseNavigation()
+Holder<Mesh> meshGenerateBaseNavigation(const MeshDensities *densities)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", "generating base navigation mesh");
-	Holder<Mesh> poly = meshGenerateGeneric<&terrainSdfNavigation>();
+	TraceScope trace("base navigation mesh");
+	Holder<Mesh> poly = meshGenerateGeneric<&terrainSdfNavigation>(densities);
 	if (poly->indicesCount() == 0)
 		CAGE_THROW_ERROR(Exception, "generated empty base navigation mesh");
 	return poly;
@@ -103,21 +513,20 @@ Holder<Mesh> meshGenerateBaseNavigation()
 void meshSimplifyNavmesh(Holder<Mesh> &mesh)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", "regularizing navigation mesh");
+	TraceScope trace("simplify navigation mesh");
 
 	if (configNavmeshOptimize)
 	{
 		unnatural::NavmeshOptimizeConfig cfg;
-#ifdef CAGE_DEBUG
-		cfg.iterations = 1;
-#endif
-		cfg.tileSize = tileSize;
+		cfg.iterations = min(cfg.iterations, (uint32)configMeshIterations);
+		cfg.tileSize = configMeshTileSize;
 		mesh = unnatural::navmeshOptimize(std::move(mesh), cfg);
 	}
 	else
 	{
 		MeshRegularizeConfig cfg;
-		cfg.iterations = iterations;
-		cfg.targetEdgeLength = tileSize;
+		cfg.iterations = configMeshIterations;
+		cfg.targetEdgeLength = (float)configMeshTileSize;
 		meshRegularize(+mesh, cfg);
 	}
 }
@@ -125,9 +534,11 @@ void meshSimplifyNavmesh(Holder<Mesh> &mesh)
 void meshSimplifyCollider(Holder<Mesh> &mesh)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", "simplifying collider mesh");
+	TraceScope trace("simplify collider mesh");
 
+	const real tileSize = (float)configMeshTileSize;
 	MeshSimplifyConfig cfg;
-	cfg.iterations = iterations;
+	cfg.iterations = configMeshIterations;
 	cfg.minEdgeLength = 0.5 * tileSize;
 	cfg.maxEdgeLength = 10 * tileSize;
 	cfg.approximateError = 0.03 * tileSize;
@@ -143,9 +554,11 @@ void meshSimplifyCollider(Holder<Mesh> &mesh)
 void meshSimplifyRender(Holder<Mesh> &mesh)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", "simplifying render mesh");
+	TraceScope trace("simplify render mesh");
 
+	const real tileSize = (float)configMeshTileSize;
 	MeshSimplifyConfig cfg;
-	cfg.iterations = iterations;
+	cfg.iterations = configMeshIterations;
 	cfg.minEdgeLength = 0.2 * tileSize;
 	cfg.maxEdgeLength = 5 * tileSize;
 	cfg.approximateError = 0.01 * tileSize;
@@ -160,6 +573,7 @@ void meshSimplifyRender(Holder<Mesh> &mesh)
 
 std::vector<Holder<Mesh>> meshSplit(const Holder<Mesh> &mesh)
 {
+	TraceScope trace("split");
 	MeshChunkingConfig cfg;
 	cfg.maxSurfaceArea = 250000;
 	auto res = meshChunking(+mesh, cfg);
@@ -172,15 +586,12 @@ std::vector<Holder<Mesh>> meshSplit(const Holder<Mesh> &mesh)
 
 uint32 meshUnwrap(const Holder<Mesh> &mesh)
 {
+	TraceScope trace("unwrap");
 	MeshUnwrapConfig cfg;
 	cfg.maxChartIterations = 10;
 	cfg.maxChartBoundaryLength = 500;
 	cfg.chartRoundness = 0.3;
-#ifdef CAGE_DEBUG
-	cfg.texelsPerUnit = 0.3;
-#else
-	cfg.texelsPerUnit = 2.5;
-#endif // CAGE_DEBUG
+	cfg.texelsPerUnit = (float)configTexelsPerUnit;
 	cfg.padding = 6;
 	return meshUnwrap(+mesh, cfg);
 }
@@ -3,10 +3,13 @@
 
 #include "terrain.h"
 #include "mesh.h"
+#include "generator.h"
+#include "trace.h"
 
 void meshSaveDebug(const string &path, const Holder<Mesh> &mesh)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "saving debug mesh: " + path);
+	TraceScope trace("save debug mesh");
 
 	MeshExportObjConfig cfg;
 	cfg.objectName = pathExtractFilenameNoExtension(path);
@@ -16,6 +19,7 @@ void meshSaveDebug(const string &path, const Holder<Mesh> &mesh)
 void meshSaveRender(const string &path, const Holder<Mesh> &mesh, bool transparency)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "saving render mesh: " + path);
+	TraceScope trace("save render mesh");
 
 	CAGE_ASSERT(mesh->normals().size() == mesh->verticesCount());
 	CAGE_ASSERT(mesh->uvs().size() == mesh->verticesCount());
@@ -27,22 +31,23 @@ void meshSaveRender(const string &path, const Holder<Mesh> &mesh, bool transpare
 
 	const string directory = pathExtractDirectory(path);
 	const string cpmName = cfg.objectName + ".cpm";
+	const string ext = textureExtension();
 
 	{ // write mtl file with link to albedo texture
 		Holder<File> f = writeFile(pathJoin(directory, cfg.materialLibraryName));
 		f->writeLine(stringizer() + "newmtl " + cfg.materialName);
-		f->writeLine(stringizer() + "map_Kd " + cfg.objectName + "-albedo.png");
-		//f->writeLine(stringizer() + "map_bump " + cfg.objectName + "-height.png");
+		f->writeLine(stringizer() + "map_Kd " + cfg.objectName + "-albedo" + ext);
+		//f->writeLine(stringizer() + "map_bump " + cfg.objectName + (textureNormalMap() ? "-normal" : "-height") + ext);
 		if (transparency)
-			f->writeLine(stringizer() + "map_d " + cfg.objectName + "-albedo.png");
+			f->writeLine(stringizer() + "map_d " + cfg.objectName + "-albedo" + ext);
 	}
 
 	{ // write cpm material file
 		Holder<File> f = newFile(pathJoin(directory, cpmName), FileMode(false, true));
 		f->writeLine("[textures]");
-		f->writeLine(stringizer() + "albedo = " + cfg.objectName + "-albedo.png");
-		f->writeLine(stringizer() + "special = " + cfg.objectName + "-special.png");
-		f->writeLine(stringizer() + "normal = " + cfg.objectName + "-height.png");
+		f->writeLine(stringizer() + "albedo = " + cfg.objectName + "-albedo" + ext);
+		f->writeLine(stringizer() + "special = " + cfg.objectName + "-special" + ext);
+		f->writeLine(stringizer() + "normal = " + cfg.objectName + (textureNormalMap() ? "-normal" : "-height") + ext);
 		if (transparency)
 		{
 			f->writeLine("[flags]");
@@ -55,6 +60,7 @@ void meshSaveRender(const string &path, const Holder<Mesh> &mesh, bool transpare
 void meshSaveNavigation(const string &path, const Holder<Mesh> &mesh, const std::vector<Tile> &tiles)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "saving navigation mesh: " + path);
+	TraceScope trace("save navigation mesh");
 
 	CAGE_ASSERT(mesh->normals().size() == mesh->verticesCount());
 	CAGE_ASSERT(tiles.size() == mesh->verticesCount());
@@ -76,6 +82,7 @@ void meshSaveNavigation(const string &path, const Holder<Mesh> &mesh, const std:
 void meshSaveCollider(const string &path, const Holder<Mesh> &mesh)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "saving collider: " + path);
+	TraceScope trace("save collider");
 
 	Holder<Mesh> m = mesh->copy();
 	m->normals({});
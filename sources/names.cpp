@@ -1,7 +1,6 @@
-#include <cage-core/math.h>
 #include <cage-core/string.h>
 
-using namespace cage;
+#include "math.h"
 
 namespace
 {
@@ -23,24 +22,24 @@ namespace
 		" I", " II", " III", " IV", " V",
 		" VI", " VII", " VIII", " IX", " X",
 	};
-#define PICK(NAMES) NAMES[randomRange(std::size_t(0), sizeof(NAMES)/sizeof(NAMES[0]))]
+#define PICK(NAMES) NAMES[rng.randomRange(std::size_t(0), sizeof(NAMES)/sizeof(NAMES[0]))]
 
-	string generateNameImpl()
+	string generateNameImpl(RandomGenerator &rng)
 	{
 		stringizer name;
-		if (randomChance() < 0.5)
+		if (rng.randomChance() < 0.5)
 			name + PICK(Prefixes);
-		if (randomChance() < 0.8)
+		if (rng.randomChance() < 0.8)
 			name + PICK(Stems);
-		if (randomChance() < 0.1)
+		if (rng.randomChance() < 0.1)
 			name + PICK(Stems);
-		if (randomChance() < 0.5)
+		if (rng.randomChance() < 0.5)
 			name + PICK(Suffixes);
 		if (string(name).length() < 3)
-			return generateNameImpl();
-		if (randomChance() < 0.1)
+			return generateNameImpl(rng);
+		if (rng.randomChance() < 0.1)
 			name = stringizer() + reverse(string(name));
-		if (randomChance() < 0.4)
+		if (rng.randomChance() < 0.4)
 			name + PICK(Appendixes);
 		return name;
 	}
@@ -48,7 +47,8 @@ namespace
 
 string generateName()
 {
-	string name = generateNameImpl();
+	RandomGenerator rng = seededRandom("name");
+	string name = generateNameImpl(rng);
 	name[0] = toUpper(string(name[0]))[0];
 	return name;
 }
@@ -110,7 +110,7 @@ real sdfMobiusStrip(const vec3 &pos)
 	return sdfMobiusStrip(pos, 700, 300, 20) - 100;
 }
 
-real sdfFibers(const vec3 &pos)
+real sdfFibers(const vec3 &pos, const vec3 &offset)
 {
 	const auto &sdGyroid = [](vec3 p, real scale, real thickness, real bias)
 	{
@@ -121,7 +121,6 @@ real sdfFibers(const vec3 &pos)
 	};
 
 	constexpr real scale = 0.002;
-	static const vec3 offset = randomRange3(-100, 100);
 	const vec3 p = pos * scale + offset;
 	const real g1 = sdGyroid(p, 3.23, 0.03, 1.4);
 	const real g2 = sdGyroid(p, 7.78, 0.05, 0.3);
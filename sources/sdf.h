@@ -20,9 +20,30 @@ real sdfHexagonalPrism(const vec3 &pos);
 real sdfTorus(const vec3 &pos);
 real sdfKnot(const vec3 &pos);
 real sdfMobiusStrip(const vec3 &pos);
-real sdfFibers(const vec3 &pos);
+real sdfFibers(const vec3 &pos, const vec3 &offset); // the offset is chosen for each planet
 real sdfH2O(const vec3 &pos);
 real sdfH3O(const vec3 &pos);
 real sdfH4O(const vec3 &pos);
 
+// batch versions evaluate many positions at once, using vector instructions where the shape allows it
+typedef void (*SdfBatchFunctor)(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+
+void sdfHexagon(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void sdfSquare(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void sdfSphere(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void sdfBox(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void sdfCube(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void sdfH2O(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void sdfH3O(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void sdfH4O(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+
+// fallback for shapes without vectorized implementation
+template<real(*F)(const vec3 &)>
+void sdfBatchScalar(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	CAGE_ASSERT(x.size() == result.size() && y.size() == result.size() && z.size() == result.size());
+	for (uint32 i = 0; i < result.size(); i++)
+		result[i] = F(vec3(x[i], y[i], z[i]));
+}
+
 #endif
@@ -0,0 +1,132 @@
+#include <cage-core/geometry.h>
+
+#include "sdf.h"
+#include "sdfSimd.h"
+
+#include <initializer_list>
+
+namespace
+{
+	static_assert(sizeof(real) == sizeof(float), "real must be binary compatible with float");
+
+	// the descriptors must match the scalar shapes in sdf.cpp
+
+	SdfSimdShape makePlane(const vec3 &normal)
+	{
+		SdfSimdShape s;
+		s.type = SdfSimdShape::TypeEnum::Plane;
+		for (uint32 i = 0; i < 3; i++)
+			s.normal[i] = normal[i].value;
+		return s;
+	}
+
+	SdfSimdShape makeSphere(real radius)
+	{
+		SdfSimdShape s;
+		s.type = SdfSimdShape::TypeEnum::Sphere;
+		s.radius = radius.value;
+		return s;
+	}
+
+	SdfSimdShape makeBox(const vec3 &halfSizes, real rounding)
+	{
+		SdfSimdShape s;
+		s.type = SdfSimdShape::TypeEnum::Box;
+		for (uint32 i = 0; i < 3; i++)
+			s.halfSizes[i] = halfSizes[i].value;
+		s.rounding = rounding.value;
+		return s;
+	}
+
+	SdfSimdShape makeMolecule(const vec3 &oxygen, std::initializer_list<vec3> hydrogens)
+	{
+		CAGE_ASSERT(hydrogens.size() > 0 && hydrogens.size() <= 4);
+		SdfSimdShape s;
+		s.type = SdfSimdShape::TypeEnum::Molecule;
+		for (uint32 i = 0; i < 3; i++)
+			s.center[i] = oxygen[i].value;
+		s.radius = 650;
+		uint32 j = 0;
+		for (const vec3 &h : hydrogens)
+		{
+			for (uint32 i = 0; i < 3; i++)
+				s.atoms[j][i] = h[i].value;
+			j++;
+		}
+		s.atomsCount = numeric_cast<uint32>(hydrogens.size());
+		s.atomRadius = 450;
+		s.smoothing = 100;
+		return s;
+	}
+
+	template<real(*F)(const vec3 &)>
+	void evaluate(const SdfSimdShape &shape, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+	{
+		CAGE_ASSERT(x.size() == result.size() && y.size() == result.size() && z.size() == result.size());
+		const auto &f = [](PointerRange<const real> r) { return (const float *)r.data(); };
+		if (!sdfSimdEvaluate(shape, f(x), f(y), f(z), (float *)result.data(), numeric_cast<uint32>(result.size())))
+		{
+			sdfBatchScalar<F>(x, y, z, result);
+			return;
+		}
+#ifdef CAGE_DEBUG
+		for (uint32 i = 0; i < result.size(); i++)
+		{
+			const real s = F(vec3(x[i], y[i], z[i]));
+			CAGE_ASSERT(abs(result[i] - s) < 0.01 + abs(s) * 1e-5);
+		}
+#endif // CAGE_DEBUG
+	}
+}
+
+void sdfHexagon(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	static const SdfSimdShape shape = makePlane(normalize(vec3(1)));
+	evaluate<&sdfHexagon>(shape, x, y, z, result);
+}
+
+void sdfSquare(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	static const SdfSimdShape shape = makePlane(vec3(0, 1, 0));
+	evaluate<&sdfSquare>(shape, x, y, z, result);
+}
+
+void sdfSphere(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	static const SdfSimdShape shape = makeSphere(1000);
+	evaluate<&sdfSphere>(shape, x, y, z, result);
+}
+
+void sdfBox(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	static const SdfSimdShape shape = makeBox(vec3(900, 500, 500), 100);
+	evaluate<&sdfBox>(shape, x, y, z, result);
+}
+
+void sdfCube(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	static const SdfSimdShape shape = makeBox(vec3(900), 100);
+	evaluate<&sdfCube>(shape, x, y, z, result);
+}
+
+void sdfH2O(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	static const SdfSimdShape shape = makeMolecule(vec3(0, -100, 0), { vec3(-550, 300, 0), vec3(+550, 300, 0) });
+	evaluate<&sdfH2O>(shape, x, y, z, result);
+}
+
+void sdfH3O(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	static const SdfSimdShape shape = makeMolecule(vec3(), {
+		quat({}, {}, degs(  0)) * vec3(680, 0, 0),
+		quat({}, {}, degs(120)) * vec3(680, 0, 0),
+		quat({}, {}, degs(240)) * vec3(680, 0, 0),
+	});
+	evaluate<&sdfH3O>(shape, x, y, z, result);
+}
+
+void sdfH4O(PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	static const SdfSimdShape shape = makeMolecule(vec3(), { vec3(-550, +400, 0), vec3(+550, +400, 0), vec3(0, -400, -550), vec3(0, -400, +550) });
+	evaluate<&sdfH4O>(shape, x, y, z, result);
+}
@@ -0,0 +1,37 @@
+#ifndef sdfSimd_h_ur8f4kq2
+#define sdfSimd_h_ur8f4kq2
+
+// this header is shared with translation units compiled with different instruction sets
+// it must not include any headers with inline functions
+
+#include <cstdint>
+
+struct SdfSimdShape
+{
+	enum class TypeEnum : std::uint32_t
+	{
+		Plane, // normal
+		Sphere, // radius
+		Box, // half sizes, rounding
+		Molecule, // oxygen center and radius, hydrogen centers and radius, smoothing
+	};
+
+	TypeEnum type = TypeEnum::Plane;
+	float normal[3] = {};
+	float halfSizes[3] = {};
+	float rounding = 0;
+	float center[3] = {};
+	float radius = 0;
+	float atoms[4][3] = {};
+	std::uint32_t atomsCount = 0;
+	float atomRadius = 0;
+	float smoothing = 0;
+};
+
+// returns false when no vectorized implementation is available
+bool sdfSimdEvaluate(const SdfSimdShape &shape, const float *x, const float *y, const float *z, float *result, std::uint32_t count);
+
+// returns false when the file was compiled without avx2
+bool sdfSimdEvaluateAvx2(const SdfSimdShape &shape, const float *x, const float *y, const float *z, float *result, std::uint32_t count);
+
+#endif
@@ -0,0 +1,49 @@
+#include "sdfSimd.h"
+
+// this file is compiled with avx2 enabled (see CMakeLists.txt)
+// it is only called after checking the cpu support at runtime
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace
+{
+	struct V
+	{
+		static constexpr std::uint32_t Width = 8;
+		__m256 v;
+
+		V(__m256 v) : v(v) {}
+		V(float s) : v(_mm256_set1_ps(s)) {}
+
+		static V load(const float *p) { return _mm256_loadu_ps(p); }
+		void store(float *p) const { _mm256_storeu_ps(p, v); }
+	};
+
+	V operator + (const V &a, const V &b) { return _mm256_add_ps(a.v, b.v); }
+	V operator - (const V &a, const V &b) { return _mm256_sub_ps(a.v, b.v); }
+	V operator * (const V &a, const V &b) { return _mm256_mul_ps(a.v, b.v); }
+	V operator / (const V &a, const V &b) { return _mm256_div_ps(a.v, b.v); }
+	V min(const V &a, const V &b) { return _mm256_min_ps(a.v, b.v); }
+	V max(const V &a, const V &b) { return _mm256_max_ps(a.v, b.v); }
+	V abs(const V &a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v); }
+	V sqrt(const V &a) { return _mm256_sqrt_ps(a.v); }
+}
+
+#include "sdfSimdKernels.h"
+
+bool sdfSimdEvaluateAvx2(const SdfSimdShape &shape, const float *x, const float *y, const float *z, float *result, std::uint32_t count)
+{
+	sdfSimdKernels::evaluate<V>(shape, x, y, z, result, count);
+	return true;
+}
+
+#else
+
+bool sdfSimdEvaluateAvx2(const SdfSimdShape &, const float *, const float *, const float *, float *, std::uint32_t)
+{
+	return false;
+}
+
+#endif
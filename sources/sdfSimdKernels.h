@@ -0,0 +1,94 @@
+#ifndef sdfSimdKernels_h_9wq1jz5c
+#define sdfSimdKernels_h_9wq1jz5c
+
+// generic kernels instantiated with a vector type defined (in anonymous namespace) by each instruction set specific translation unit
+// the vector type must provide: static Width, splat constructor, load, store, arithmetic operators, min, max, abs, sqrt
+
+#include "sdfSimd.h"
+
+namespace sdfSimdKernels
+{
+	template<class V>
+	V length(const V &x, const V &y, const V &z)
+	{
+		return sqrt(x * x + y * y + z * z);
+	}
+
+	template<class V>
+	V plane(const SdfSimdShape &s, const V &x, const V &y, const V &z)
+	{
+		return x * V(s.normal[0]) + y * V(s.normal[1]) + z * V(s.normal[2]);
+	}
+
+	template<class V>
+	V sphere(const SdfSimdShape &s, const V &x, const V &y, const V &z)
+	{
+		return length(x, y, z) - V(s.radius);
+	}
+
+	template<class V>
+	V box(const SdfSimdShape &s, const V &x, const V &y, const V &z)
+	{
+		const V zero = V(0.f);
+		const V qx = abs(x) - V(s.halfSizes[0]);
+		const V qy = abs(y) - V(s.halfSizes[1]);
+		const V qz = abs(z) - V(s.halfSizes[2]);
+		const V outside = length(max(qx, zero), max(qy, zero), max(qz, zero));
+		const V inside = min(max(qx, max(qy, qz)), zero);
+		return outside + inside - V(s.rounding);
+	}
+
+	template<class V>
+	V smoothMin(const V &a, const V &b, const V &k)
+	{
+		// https://www.shadertoy.com/view/3ssGWj
+		const V h = min(max((b - a) / k * V(0.5f) + V(0.5f), V(0.f)), V(1.f));
+		return b * (V(1.f) - h) + a * h - k * h * (V(1.f) - h);
+	}
+
+	template<class V>
+	V molecule(const SdfSimdShape &s, const V &x, const V &y, const V &z)
+	{
+		const V o = length(x - V(s.center[0]), y - V(s.center[1]), z - V(s.center[2])) - V(s.radius);
+		V h = length(x - V(s.atoms[0][0]), y - V(s.atoms[0][1]), z - V(s.atoms[0][2]));
+		for (std::uint32_t i = 1; i < s.atomsCount; i++)
+			h = min(h, length(x - V(s.atoms[i][0]), y - V(s.atoms[i][1]), z - V(s.atoms[i][2])));
+		return smoothMin(o, h - V(s.atomRadius), V(s.smoothing));
+	}
+
+	template<class V, V(*K)(const SdfSimdShape &, const V &, const V &, const V &)>
+	void evaluateKernel(const SdfSimdShape &s, const float *x, const float *y, const float *z, float *result, std::uint32_t count)
+	{
+		std::uint32_t i = 0;
+		for (; i + V::Width <= count; i += V::Width)
+			K(s, V::load(x + i), V::load(y + i), V::load(z + i)).store(result + i);
+		if (i < count)
+		{
+			// pad the tail with zeros
+			float tx[V::Width] = {}, ty[V::Width] = {}, tz[V::Width] = {}, tr[V::Width];
+			for (std::uint32_t j = i; j < count; j++)
+			{
+				tx[j - i] = x[j];
+				ty[j - i] = y[j];
+				tz[j - i] = z[j];
+			}
+			K(s, V::load(tx), V::load(ty), V::load(tz)).store(tr);
+			for (std::uint32_t j = i; j < count; j++)
+				result[j] = tr[j - i];
+		}
+	}
+
+	template<class V>
+	void evaluate(const SdfSimdShape &s, const float *x, const float *y, const float *z, float *result, std::uint32_t count)
+	{
+		switch (s.type)
+		{
+		case SdfSimdShape::TypeEnum::Plane: return evaluateKernel<V, &plane<V>>(s, x, y, z, result, count);
+		case SdfSimdShape::TypeEnum::Sphere: return evaluateKernel<V, &sphere<V>>(s, x, y, z, result, count);
+		case SdfSimdShape::TypeEnum::Box: return evaluateKernel<V, &box<V>>(s, x, y, z, result, count);
+		case SdfSimdShape::TypeEnum::Molecule: return evaluateKernel<V, &molecule<V>>(s, x, y, z, result, count);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include "sdfSimd.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
+namespace
+{
+	struct V
+	{
+		static constexpr std::uint32_t Width = 4;
+		__m128 v;
+
+		V(__m128 v) : v(v) {}
+		V(float s) : v(_mm_set1_ps(s)) {}
+
+		static V load(const float *p) { return _mm_loadu_ps(p); }
+		void store(float *p) const { _mm_storeu_ps(p, v); }
+	};
+
+	V operator + (const V &a, const V &b) { return _mm_add_ps(a.v, b.v); }
+	V operator - (const V &a, const V &b) { return _mm_sub_ps(a.v, b.v); }
+	V operator * (const V &a, const V &b) { return _mm_mul_ps(a.v, b.v); }
+	V operator / (const V &a, const V &b) { return _mm_div_ps(a.v, b.v); }
+	V min(const V &a, const V &b) { return _mm_min_ps(a.v, b.v); }
+	V max(const V &a, const V &b) { return _mm_max_ps(a.v, b.v); }
+	V abs(const V &a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+	V sqrt(const V &a) { return _mm_sqrt_ps(a.v); }
+}
+
+#include "sdfSimdKernels.h"
+
+namespace
+{
+	bool avx2Available()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		if (!osxsave || !fma)
+			return false;
+		if ((_xgetbv(0) & 6) != 6)
+			return false; // the os does not preserve ymm registers
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif // _MSC_VER
+	}
+}
+
+bool sdfSimdEvaluate(const SdfSimdShape &shape, const float *x, const float *y, const float *z, float *result, std::uint32_t count)
+{
+	static const bool avx2 = avx2Available();
+	if (!avx2 || !sdfSimdEvaluateAvx2(shape, x, y, z, result, count))
+		sdfSimdKernels::evaluate<V>(shape, x, y, z, result, count);
+	return true;
+}
+
+#else
+
+bool sdfSimdEvaluate(const SdfSimdShape &, const float *, const float *, const float *, float *, std::uint32_t)
+{
+	return false;
+}
+
+#endif
@@ -49,6 +49,7 @@ struct Tile
 	real height; // bump map value
 	real elevation; // (meters) above sea
 	rads slope;
+	vec3 gradient; // (meters per unit) elevation change along the surface
 	real temperature; // °C average annual
 	real precipitation; // cm total annual
 	real opacity = 1; // only applies to water
@@ -56,15 +57,36 @@ struct Tile
 	TerrainTypeEnum type;
 };
 
-real terrainSdfElevation(const vec3 &pos);
-real terrainSdfElevationRaw(const vec3 &pos);
-real terrainSdfLand(const vec3 &pos);
-real terrainSdfWater(const vec3 &pos);
-real terrainSdfNavigation(const vec3 &pos);
-void terrainTileLand(Tile &tile);
-void terrainTileWater(Tile &tile);
-void terrainTileNavigation(Tile &tile);
-void terrainPreseed();
+constexpr float terrainBoxSize = 2500; // the planets are generated inside a cube of this size centered at the origin
+
+// noise functions and configuration of one planet
+class TerrainContext : private Immovable
+{};
+
+Holder<TerrainContext> newTerrainContext(); // uses the current planet seed and configuration
+
+real terrainSdfElevation(const TerrainContext *context, const vec3 &pos);
+real terrainSdfElevationRaw(const TerrainContext *context, const vec3 &pos);
+real terrainSdfLand(const TerrainContext *context, const vec3 &pos);
+real terrainSdfWater(const TerrainContext *context, const vec3 &pos);
+real terrainSdfNavigation(const TerrainContext *context, const vec3 &pos);
+real terrainSdfLand(real shape, real elevationRaw);
+real terrainSdfWater(real shape, real elevationRaw);
+real terrainSdfNavigation(real shape, real elevationRaw);
+void terrainSdfElevation(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void terrainSdfElevationRaw(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void terrainSdfLand(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void terrainSdfWater(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void terrainSdfNavigation(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+void terrainSdfDensities(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> shapes, PointerRange<real> elevationsRaw); // water (bare shape) and raw elevation together
+real terrainSdfDisplacementBound(const TerrainContext *context); // maximum distance of the land surface from the bare shape
+void terrainSdfBenchmark(const TerrainContext *context); // logs the timings of the land sdf evaluated through the individual paths
+void terrainTileLand(const TerrainContext *context, Tile &tile);
+void terrainTileWater(const TerrainContext *context, Tile &tile);
+void terrainTileNavigation(const TerrainContext *context, Tile &tile);
+void terrainTileLand(const TerrainContext *context, PointerRange<Tile> tiles); // the whole batch is evaluated together, prefer over the individual tiles
+void terrainTileWater(const TerrainContext *context, PointerRange<Tile> tiles);
+void terrainTileNavigation(const TerrainContext *context, PointerRange<Tile> tiles);
 void terrainApplyConfig();
 
 #endif
@@ -0,0 +1,20 @@
+#ifndef terrainContext_h_q7d2mx9w
+#define terrainContext_h_q7d2mx9w
+
+#include "terrain.h"
+
+// parts of the context are defined in the source files that use them
+struct TerrainElevationContext;
+struct TerrainPropertiesContext;
+
+class TerrainContextImpl : public TerrainContext
+{
+public:
+	Holder<TerrainElevationContext> elevation;
+	Holder<TerrainPropertiesContext> properties;
+};
+
+Holder<TerrainElevationContext> newTerrainElevationContext();
+Holder<TerrainPropertiesContext> newTerrainPropertiesContext(const TerrainContext *context);
+
+#endif
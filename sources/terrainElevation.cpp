@@ -1,83 +1,63 @@
 #include <cage-core/noiseFunction.h>
 #include <cage-core/config.h>
+#include <cage-core/random.h>
 
 #include "terrain.h"
 #include "sdf.h"
+#include "terrainContext.h"
 #include "math.h"
 
+#include <array>
+#include <chrono>
+#include <utility>
+#include <vector>
+
 namespace
 {
 	ConfigString configShapeMode("unnatural-planets/shape/mode");
 	ConfigString configElevationMode("unnatural-planets/elevation/mode");
 
 	typedef real (*TerrainFunctor)(const vec3 &);
-	TerrainFunctor terrainElevationFnc = 0;
-	TerrainFunctor terrainShapeFnc = 0;
-
-	real elevationNone(const vec3 &)
-	{
-		return 100;
-	}
 
-	real elevationSimple(const vec3 &pos)
+	// noise functions of all elevation modes and the random parameters of the shapes, owned by the context
+	struct ElevationNoises
 	{
-		static const Holder<NoiseFunction> elevNoise = []() {
+		const vec3 fibersOffset = seededRandom("fibers").randomRange3(-100, 100);
+		const Holder<NoiseFunction> simpleElevNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Simplex;
 			cfg.fractalType = NoiseFractalTypeEnum::Ridged;
 			cfg.octaves = 6;
 			cfg.gain = 0.4;
 			cfg.frequency = 0.0005;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("elevationSimple/elevNoise");
 			return newNoiseFunction(cfg);
 		}();
-
-		real a = elevNoise->evaluate(pos); // min: -0.8, mean: 0.28, max: 1
-		a = -a + 0.3; // min: -0.7, mean: 0.02, max: 1.1
-		a = pow(a * 1.3 - 0.35, 3) + 0.1;
-		return 100 - a * 1000;
-	}
-
-	real elevationLegacy(const vec3 &pos)
-	{
-		static const Holder<NoiseFunction> scaleNoise = []() {
+		const Holder<NoiseFunction> legacyScaleNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Value;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.0005;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("elevationLegacy/scaleNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> elevNoise = []() {
+		const Holder<NoiseFunction> legacyElevNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Value;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("elevationLegacy/elevNoise");
 			return newNoiseFunction(cfg);
 		}();
-
-		real scale = scaleNoise->evaluate(pos) * 0.0005 + 0.0015;
-		real a = elevNoise->evaluate(pos * scale);
-		a += 0.11; // slightly prefer terrain over ocean
-		if (a < 0)
-			a = -pow(-a, 0.85);
-		else
-			a = pow(a, 1.7);
-		return a * 2500;
-	}
-
-	real commonElevationMountains(const vec3 &pos, real land)
-	{
-		static const Holder<NoiseFunction> maskNoise = []() {
+		const Holder<NoiseFunction> mountainsMaskNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.frequency = 0.0015;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("commonElevationMountains/maskNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> ridgeNoise = []() {
+		const Holder<NoiseFunction> mountainsRidgeNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Simplex;
 			cfg.fractalType = NoiseFractalTypeEnum::Ridged;
@@ -85,35 +65,83 @@ namespace
 			cfg.lacunarity = 1.5;
 			cfg.gain = -0.4;
 			cfg.frequency = 0.001;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("commonElevationMountains/ridgeNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> terraceNoise = []() {
+		const Holder<NoiseFunction> mountainsTerraceNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 3;
 			cfg.gain = 0.3;
 			cfg.frequency = 0.002;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("commonElevationMountains/terraceNoise");
 			return newNoiseFunction(cfg);
 		}();
+		const Holder<NoiseFunction> lakesElevNoise = []() {
+			NoiseFunctionCreateConfig cfg;
+			cfg.type = NoiseTypeEnum::Value;
+			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
+			cfg.octaves = 4;
+			cfg.frequency = 0.0013;
+			cfg.seed = noiseSeed("elevationLakes/elevLand");
+			return newNoiseFunction(cfg);
+		}();
+		const Holder<NoiseFunction> islandsElevNoise = []() {
+			NoiseFunctionCreateConfig cfg;
+			cfg.type = NoiseTypeEnum::Value;
+			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
+			cfg.octaves = 4;
+			cfg.frequency = 0.0013;
+			cfg.seed = noiseSeed("elevationIslands/elevLand");
+			return newNoiseFunction(cfg);
+		}();
+	};
+
+	typedef real (*ElevationFunctor)(const ElevationNoises &, const vec3 &);
+
+	real elevationNone(const ElevationNoises &, const vec3 &)
+	{
+		return 100;
+	}
+
+	real elevationSimple(const ElevationNoises &noises, const vec3 &pos)
+	{
+		real a = noises.simpleElevNoise->evaluate(pos); // min: -0.8, mean: 0.28, max: 1
+		a = -a + 0.3; // min: -0.7, mean: 0.02, max: 1.1
+		a = pow(a * 1.3 - 0.35, 3) + 0.1;
+		return 100 - a * 1000;
+	}
 
+	real elevationLegacy(const ElevationNoises &noises, const vec3 &pos)
+	{
+		real scale = noises.legacyScaleNoise->evaluate(pos) * 0.0005 + 0.0015;
+		real a = noises.legacyElevNoise->evaluate(pos * scale);
+		a += 0.11; // slightly prefer terrain over ocean
+		if (a < 0)
+			a = -pow(-a, 0.85);
+		else
+			a = pow(a, 1.7);
+		return a * 2500;
+	}
+
+	real commonElevationMountains(const ElevationNoises &noises, const vec3 &pos, real land)
+	{
 		real cover = 1 - saturate(land * -0.1); // no mountains in the water
 		if (cover < 1e-7)
 			return land;
 
-		real mask = maskNoise->evaluate(pos);
+		real mask = noises.mountainsMaskNoise->evaluate(pos);
 		real rm = smoothstep(saturate(mask * +7 - 0.3));
 		real tm = smoothstep(saturate(mask * -7 - 1.5));
 
-		real ridge = ridgeNoise->evaluate(pos);
+		real ridge = noises.mountainsRidgeNoise->evaluate(pos);
 		ridge = max(ridge - 0.1, 0);
 		ridge = pow(ridge, 1.6);
 		ridge *= rm * cover;
 		ridge *= 1000;
 
-		real terraces = terraceNoise->evaluate(pos);
+		real terraces = noises.mountainsTerraceNoise->evaluate(pos);
 		terraces = max(terraces + 0.1, 0) * 2.5;
 		terraces = terrace(terraces, 4);
 		terraces *= tm * cover;
@@ -125,209 +153,514 @@ namespace
 	// lakes & islands
 	// https://www.wolframalpha.com/input/?i=plot+%28%28%281+-+x%5E0.85%29+*+2+-+1%29+%2F+%28abs%28%28%281+-+x%5E0.85%29+*+2+-+1%29%29+%2B+0.17%29+%2B+0.15%29+*+150+%2C+%28%28%281+-+x%5E1.24%29+*+2+-+1%29+%2F+%28abs%28%28%281+-+x%5E1.24%29+*+2+-+1%29%29+%2B+0.17%29+%2B+0.15%29+*+150+%2C+x+%3D+0+..+1
 
-	real elevationLakes(const vec3 &pos)
+	real elevationLakes(const ElevationNoises &noises, const vec3 &pos)
 	{
-		static const Holder<NoiseFunction> elevLand = []() {
-			NoiseFunctionCreateConfig cfg;
-			cfg.type = NoiseTypeEnum::Value;
-			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
-			cfg.octaves = 4;
-			cfg.frequency = 0.0013;
-			cfg.seed = noiseSeed();
-			return newNoiseFunction(cfg);
-		}();
-
-		real land = elevLand->evaluate(pos) * 0.5 + 0.5;
+		real land = noises.lakesElevNoise->evaluate(pos) * 0.5 + 0.5;
 		land = saturate(land);
 		land = 1 - pow(land, 1.24);
 		land = land * 2 - 1;
 		land = land / (abs(land) + 0.17) + 0.15;
 		land *= 150;
-		return commonElevationMountains(pos, land);
+		return commonElevationMountains(noises, pos, land);
 	}
 
-	real elevationIslands(const vec3& pos)
+	real elevationIslands(const ElevationNoises &noises, const vec3 &pos)
 	{
-		static const Holder<NoiseFunction> elevLand = []() {
-			NoiseFunctionCreateConfig cfg;
-			cfg.type = NoiseTypeEnum::Value;
-			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
-			cfg.octaves = 4;
-			cfg.frequency = 0.0013;
-			cfg.seed = noiseSeed();
-			return newNoiseFunction(cfg);
-		}();
-
-		real land = elevLand->evaluate(pos) * 0.5 + 0.5;
+		real land = noises.islandsElevNoise->evaluate(pos) * 0.5 + 0.5;
 		land = saturate(land);
 		land = 1 - pow(land, 0.83);
 		land = land * 2 - 1;
 		land = land / (abs(land) + 0.17) + 0.15;
 		land *= 150;
-		return commonElevationMountains(pos, land);
+		return commonElevationMountains(noises, pos, land);
 	}
 
-	void chooseElevationFunction()
+	constexpr ElevationFunctor elevationModeFunctions[] = {
+		&elevationNone,
+		&elevationSimple,
+		&elevationLegacy,
+		&elevationLakes,
+		&elevationIslands,
+	};
+
+	constexpr uint32 elevationModesCount = sizeof(elevationModeFunctions) / sizeof(elevationModeFunctions[0]);
+
+	constexpr const char *const elevationModeNames[] = {
+		"none",
+		"simple",
+		"legacy",
+		"lakes",
+		"islands",
+	};
+
+	static_assert(elevationModesCount == sizeof(elevationModeNames) / sizeof(elevationModeNames[0]), "number of functions and names must match");
+
+	// conservative limits of the absolute values returned by the functions
+	constexpr float elevationModeBounds[] = {
+		100,
+		2200,
+		3000,
+		1200,
+		1200,
+	};
+
+	static_assert(elevationModesCount == sizeof(elevationModeBounds) / sizeof(elevationModeBounds[0]), "number of functions and bounds must match");
+
+	constexpr TerrainFunctor shapeModeFunctions[] = {
+		&sdfHexagon,
+		&sdfSquare,
+		&sdfSphere,
+		&sdfTorus,
+		&sdfTube,
+		&sdfDisk,
+		&sdfCapsule,
+		&sdfBox,
+		&sdfCube,
+		&sdfTetrahedron,
+		&sdfOctahedron,
+		&sdfKnot,
+		&sdfMobiusStrip,
+		nullptr, // fibers use the offset from the context, see TerrainKernel::shape
+		&sdfH2O,
+		&sdfH3O,
+		&sdfH4O,
+		&sdfTriangularPrism,
+		&sdfHexagonalPrism,
+	};
+
+	constexpr uint32 shapeModesCount = sizeof(shapeModeFunctions) / sizeof(shapeModeFunctions[0]);
+
+	constexpr const char *const shapeModeNames[] = {
+		"hexagon",
+		"square",
+		"sphere",
+		"torus",
+		"tube",
+		"disk",
+		"capsule",
+		"box",
+		"cube",
+		"tetrahedron",
+		"octahedron",
+		"knot",
+		"mobiusstrip",
+		"fibers",
+		"h2o",
+		"h3o",
+		"h4o",
+		"triangularprism",
+		"hexagonalprism",
+	};
+
+	static_assert(shapeModesCount == sizeof(shapeModeNames) / sizeof(shapeModeNames[0]), "number of functions and names must match");
+
+	constexpr SdfBatchFunctor shapeModeBatchFunctions[] = {
+		&sdfHexagon,
+		&sdfSquare,
+		&sdfSphere,
+		&sdfBatchScalar<&sdfTorus>,
+		&sdfBatchScalar<&sdfTube>,
+		&sdfBatchScalar<&sdfDisk>,
+		&sdfBatchScalar<&sdfCapsule>,
+		&sdfBox,
+		&sdfCube,
+		&sdfBatchScalar<&sdfTetrahedron>,
+		&sdfBatchScalar<&sdfOctahedron>,
+		&sdfBatchScalar<&sdfKnot>,
+		&sdfBatchScalar<&sdfMobiusStrip>,
+		nullptr, // fibers
+		&sdfH2O,
+		&sdfH3O,
+		&sdfH4O,
+		&sdfBatchScalar<&sdfTriangularPrism>,
+		&sdfBatchScalar<&sdfHexagonalPrism>,
+	};
+
+	static_assert(shapeModesCount == sizeof(shapeModeBatchFunctions) / sizeof(shapeModeBatchFunctions[0]), "number of functions and batch functions must match");
+
+	constexpr bool namesEqual(const char *a, const char *b)
 	{
-		constexpr TerrainFunctor elevationModeFunctions[] = {
-			&elevationNone,
-			&elevationSimple,
-			&elevationLegacy,
-			&elevationLakes,
-			&elevationIslands,
-		};
-
-		constexpr uint32 elevationModesCount = sizeof(elevationModeFunctions) / sizeof(elevationModeFunctions[0]);
-
-		constexpr const char *const elevationModeNames[] = {
-			"none",
-			"simple",
-			"legacy",
-			"lakes",
-			"islands",
-		};
-
-		static_assert(elevationModesCount == sizeof(elevationModeNames) / sizeof(elevationModeNames[0]), "number of functions and names must match");
-
-		for (uint32 i = 0; i < elevationModesCount; i++)
-			if ((string)configElevationMode == elevationModeNames[i])
-				terrainElevationFnc = elevationModeFunctions[i];
-		if (!terrainElevationFnc)
+		while (*a && *a == *b)
 		{
-			CAGE_LOG_THROW(stringizer() + "elevation mode: '" + (string)configElevationMode + "'");
-			CAGE_THROW_ERROR(Exception, "unknown elevation mode configuration");
+			a++;
+			b++;
 		}
-		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "using elevation mode: '" + (string)configElevationMode + "'");
+		return *a == *b;
+	}
+
+	constexpr uint32 findShapeIndex(const char *name)
+	{
+		for (uint32 i = 0; i < shapeModesCount; i++)
+			if (namesEqual(shapeModeNames[i], name))
+				return i;
+		return m;
 	}
 
-	void chooseShapeFunction()
+	constexpr uint32 fibersShapeIndex = findShapeIndex("fibers");
+	static_assert(fibersShapeIndex < shapeModesCount);
+
+	constexpr real meshElevationRatio = 10;
+
+	real combineLand(real shape, real elevationRaw)
 	{
-		constexpr TerrainFunctor shapeModeFunctions[] = {
-			&sdfHexagon,
-			&sdfSquare,
-			&sdfSphere,
-			&sdfTorus,
-			&sdfTube,
-			&sdfDisk,
-			&sdfCapsule,
-			&sdfBox,
-			&sdfCube,
-			&sdfTetrahedron,
-			&sdfOctahedron,
-			&sdfKnot,
-			&sdfMobiusStrip,
-			&sdfFibers,
-			&sdfH2O,
-			&sdfH3O,
-			&sdfH4O,
-			&sdfTriangularPrism,
-			&sdfHexagonalPrism,
-		};
-
-		constexpr uint32 shapeModesCount = sizeof(shapeModeFunctions) / sizeof(shapeModeFunctions[0]);
-
-		constexpr const char *const shapeModeNames[] = {
-			"hexagon",
-			"square",
-			"sphere",
-			"torus",
-			"tube",
-			"disk",
-			"capsule",
-			"box",
-			"cube",
-			"tetrahedron",
-			"octahedron",
-			"knot",
-			"mobiusstrip",
-			"fibers",
-			"h2o",
-			"h3o",
-			"h4o",
-			"triangularprism",
-			"hexagonalprism",
-		};
-
-		static_assert(shapeModesCount == sizeof(shapeModeNames) / sizeof(shapeModeNames[0]), "number of functions and names must match");
-
-		string name = configShapeMode;
-		if (name == "random")
+		return shape - elevationRaw / meshElevationRatio;
+	}
+
+	real combineNavigation(real shape, real elevationRaw)
+	{
+		return shape - max(elevationRaw / meshElevationRatio, 0);
+	}
+
+	typedef real (*TerrainKernelFunctor)(const ElevationNoises &, const vec3 &);
+	typedef void (*TerrainBatchFunctor)(const ElevationNoises &, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result);
+
+	// all functions for one combination of shape and elevation mode
+	struct TerrainKernels
+	{
+		TerrainKernelFunctor elevation = nullptr;
+		TerrainKernelFunctor elevationRaw = nullptr;
+		TerrainKernelFunctor land = nullptr;
+		TerrainKernelFunctor water = nullptr;
+		TerrainKernelFunctor navigation = nullptr;
+		TerrainBatchFunctor elevationBatch = nullptr;
+		TerrainBatchFunctor elevationRawBatch = nullptr;
+		TerrainBatchFunctor landBatch = nullptr;
+		TerrainBatchFunctor waterBatch = nullptr;
+		TerrainBatchFunctor navigationBatch = nullptr;
+		void (*densitiesBatch)(const ElevationNoises &, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> shapes, PointerRange<real> elevations) = nullptr;
+	};
+
+	// instantiated for every combination so that the elevation is inlined into the loops and composed with the shape without indirect calls
+	template<uint32 S, uint32 E>
+	struct TerrainKernel
+	{
+		static constexpr TerrainFunctor Shape = shapeModeFunctions[S];
+		static constexpr SdfBatchFunctor ShapeBatch = shapeModeBatchFunctions[S];
+		static constexpr ElevationFunctor Elevation = elevationModeFunctions[E];
+
+		static real shape(const ElevationNoises &n, const vec3 &pos)
 		{
-			const uint32 i = randomRange(0u, shapeModesCount);
-			terrainShapeFnc = shapeModeFunctions[i];
-			configShapeMode = name = shapeModeNames[i];
-			CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "randomly chosen shape mode: '" + name + "'");
+			if constexpr (S == fibersShapeIndex)
+				return sdfFibers(pos, n.fibersOffset);
+			else
+				return Shape(pos);
 		}
-		else
+
+		static void shapeBatch(const ElevationNoises &n, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
 		{
-			for (uint32 i = 0; i < shapeModesCount; i++)
-				if (name == shapeModeNames[i])
-					terrainShapeFnc = shapeModeFunctions[i];
-			if (!terrainShapeFnc)
+			if constexpr (S == fibersShapeIndex)
 			{
-				CAGE_LOG_THROW(stringizer() + "shape mode: '" + name + "'");
-				CAGE_THROW_ERROR(Exception, "unknown shape mode configuration");
+				CAGE_ASSERT(x.size() == result.size() && y.size() == result.size() && z.size() == result.size());
+				for (uint32 i = 0; i < result.size(); i++)
+					result[i] = sdfFibers(vec3(x[i], y[i], z[i]), n.fibersOffset);
 			}
-			CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "using shape mode: '" + name + "'");
+			else
+				ShapeBatch(x, y, z, result);
 		}
+
+		static real elevation(const ElevationNoises &n, const vec3 &pos) { return shape(n, pos) * meshElevationRatio; }
+		static real elevationRaw(const ElevationNoises &n, const vec3 &pos) { return Elevation(n, pos); }
+		static real land(const ElevationNoises &n, const vec3 &pos) { return combineLand(shape(n, pos), Elevation(n, pos)); }
+		static real water(const ElevationNoises &n, const vec3 &pos) { return shape(n, pos); }
+		static real navigation(const ElevationNoises &n, const vec3 &pos) { return combineNavigation(shape(n, pos), Elevation(n, pos)); }
+
+		static void elevationBatch(const ElevationNoises &n, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+		{
+			shapeBatch(n, x, y, z, result);
+			for (real &r : result)
+				r *= meshElevationRatio;
+		}
+
+		static void elevationRawBatch(const ElevationNoises &n, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+		{
+			CAGE_ASSERT(x.size() == result.size() && y.size() == result.size() && z.size() == result.size());
+			for (uint32 i = 0; i < result.size(); i++)
+				result[i] = Elevation(n, vec3(x[i], y[i], z[i]));
+		}
+
+		static void landBatch(const ElevationNoises &n, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+		{
+			shapeBatch(n, x, y, z, result);
+			for (uint32 i = 0; i < result.size(); i++)
+				result[i] = combineLand(result[i], Elevation(n, vec3(x[i], y[i], z[i])));
+		}
+
+		static void waterBatch(const ElevationNoises &n, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+		{
+			shapeBatch(n, x, y, z, result);
+		}
+
+		static void navigationBatch(const ElevationNoises &n, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+		{
+			shapeBatch(n, x, y, z, result);
+			for (uint32 i = 0; i < result.size(); i++)
+				result[i] = combineNavigation(result[i], Elevation(n, vec3(x[i], y[i], z[i])));
+		}
+
+		static void densitiesBatch(const ElevationNoises &n, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> shapes, PointerRange<real> elevations)
+		{
+			CAGE_ASSERT(shapes.size() == elevations.size());
+			shapeBatch(n, x, y, z, shapes);
+			elevationRawBatch(n, x, y, z, elevations);
+		}
+
+		static constexpr TerrainKernels kernels()
+		{
+			TerrainKernels k;
+			k.elevation = &elevation;
+			k.elevationRaw = &elevationRaw;
+			k.land = &land;
+			k.water = &water;
+			k.navigation = &navigation;
+			k.elevationBatch = &elevationBatch;
+			k.elevationRawBatch = &elevationRawBatch;
+			k.landBatch = &landBatch;
+			k.waterBatch = &waterBatch;
+			k.navigationBatch = &navigationBatch;
+			k.densitiesBatch = &densitiesBatch;
+			return k;
+		}
+	};
+
+	template<uint32... Is>
+	constexpr std::array<TerrainKernels, sizeof...(Is)> makeKernelsTable(std::integer_sequence<uint32, Is...>)
+	{
+		return { TerrainKernel<Is / elevationModesCount, Is % elevationModesCount>::kernels()... };
 	}
 
-	constexpr real meshElevationRatio = 10;
+	constexpr std::array<TerrainKernels, shapeModesCount * elevationModesCount> kernelsTable = makeKernelsTable(std::make_integer_sequence<uint32, shapeModesCount * elevationModesCount>());
+
+	uint32 findElevationMode(const string &name)
+	{
+		for (uint32 i = 0; i < elevationModesCount; i++)
+			if (name == elevationModeNames[i])
+				return i;
+		CAGE_LOG_THROW(stringizer() + "elevation mode: '" + name + "'");
+		CAGE_THROW_ERROR(Exception, "unknown elevation mode configuration");
+	}
+
+	uint32 findShapeMode(const string &name)
+	{
+		for (uint32 i = 0; i < shapeModesCount; i++)
+			if (name == shapeModeNames[i])
+				return i;
+		CAGE_LOG_THROW(stringizer() + "shape mode: '" + name + "'");
+		CAGE_THROW_ERROR(Exception, "unknown shape mode configuration");
+	}
+
+	real validate(real result, const char *error)
+	{
+		if (!valid(result))
+			CAGE_THROW_ERROR(Exception, error);
+		return result;
+	}
+
+	void validateBatch(PointerRange<const real> result, const char *error)
+	{
+		for (real r : result)
+			if (!valid(r))
+				CAGE_THROW_ERROR(Exception, error);
+	}
 }
 
-real terrainSdfElevation(const vec3 &pos)
+struct TerrainElevationContext
 {
-	CAGE_ASSERT(terrainShapeFnc != nullptr);
-	const real result = terrainShapeFnc(pos) * meshElevationRatio;
-	if (!valid(result))
-		CAGE_THROW_ERROR(Exception, "invalid elevation sdf value");
-	return result;
+	ElevationNoises noises;
+	const TerrainKernels *kernels = nullptr;
+	TerrainFunctor shape = nullptr; // only used by the benchmark, to compare with the separate indirect calls
+	ElevationFunctor elevation = nullptr;
+	real bound = 0;
+};
+
+Holder<TerrainElevationContext> newTerrainElevationContext()
+{
+	Holder<TerrainElevationContext> ctx = systemMemory().createHolder<TerrainElevationContext>();
+	const uint32 shapeModeIndex = findShapeMode(configShapeMode);
+	const uint32 elevationModeIndex = findElevationMode(configElevationMode);
+	ctx->kernels = &kernelsTable[shapeModeIndex * elevationModesCount + elevationModeIndex];
+	ctx->shape = shapeModeFunctions[shapeModeIndex];
+	ctx->elevation = elevationModeFunctions[elevationModeIndex];
+	ctx->bound = elevationModeBounds[elevationModeIndex];
+	return ctx;
 }
 
-real terrainSdfElevationRaw(const vec3 &pos)
+Holder<TerrainContext> newTerrainContext()
 {
-	CAGE_ASSERT(terrainElevationFnc != nullptr);
-	const real result = terrainElevationFnc(pos);
-	if (!valid(result))
-		CAGE_THROW_ERROR(Exception, "invalid elevation raw sdf value");
-	return result;
+	Holder<TerrainContext> ctx = systemMemory().createImpl<TerrainContext, TerrainContextImpl>();
+	TerrainContextImpl *impl = (TerrainContextImpl *)+ctx;
+	impl->elevation = newTerrainElevationContext();
+	impl->properties = newTerrainPropertiesContext(+ctx);
+	return ctx;
 }
 
-real terrainSdfLand(const vec3 &pos)
+namespace
 {
-	CAGE_ASSERT(terrainShapeFnc != nullptr);
-	CAGE_ASSERT(terrainElevationFnc != nullptr);
-	const real base = terrainShapeFnc(pos);
-	const real elev = terrainElevationFnc(pos) / meshElevationRatio;
-	const real result = base - elev;
-	if (!valid(result))
-		CAGE_THROW_ERROR(Exception, "invalid land sdf value");
-	return result;
+	const TerrainElevationContext *elevationContext(const TerrainContext *context)
+	{
+		CAGE_ASSERT(context);
+		const TerrainElevationContext *ctx = +((const TerrainContextImpl *)context)->elevation;
+		CAGE_ASSERT(ctx && ctx->kernels);
+		return ctx;
+	}
 }
 
-real terrainSdfWater(const vec3 &pos)
+real terrainSdfElevation(const TerrainContext *context, const vec3 &pos)
 {
-	CAGE_ASSERT(terrainShapeFnc != nullptr);
-	const real result = terrainShapeFnc(pos);
-	if (!valid(result))
-		CAGE_THROW_ERROR(Exception, "invalid water sdf value");
-	return result;
+	const TerrainElevationContext *ctx = elevationContext(context);
+	return validate(ctx->kernels->elevation(ctx->noises, pos), "invalid elevation sdf value");
 }
 
-real terrainSdfNavigation(const vec3 &pos)
+real terrainSdfElevationRaw(const TerrainContext *context, const vec3 &pos)
 {
-	CAGE_ASSERT(terrainShapeFnc != nullptr);
-	CAGE_ASSERT(terrainElevationFnc != nullptr);
-	const real base = terrainShapeFnc(pos);
-	const real elev = terrainElevationFnc(pos) / meshElevationRatio;
-	const real result = base - max(elev, 0);
-	if (!valid(result))
-		CAGE_THROW_ERROR(Exception, "invalid navigation sdf value");
-	return result;
+	const TerrainElevationContext *ctx = elevationContext(context);
+	return validate(ctx->kernels->elevationRaw(ctx->noises, pos), "invalid elevation raw sdf value");
+}
+
+real terrainSdfLand(const TerrainContext *context, const vec3 &pos)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	return validate(ctx->kernels->land(ctx->noises, pos), "invalid land sdf value");
+}
+
+real terrainSdfWater(const TerrainContext *context, const vec3 &pos)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	return validate(ctx->kernels->water(ctx->noises, pos), "invalid water sdf value");
+}
+
+real terrainSdfNavigation(const TerrainContext *context, const vec3 &pos)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	return validate(ctx->kernels->navigation(ctx->noises, pos), "invalid navigation sdf value");
+}
+
+real terrainSdfLand(real shape, real elevationRaw)
+{
+	return combineLand(shape, elevationRaw);
+}
+
+real terrainSdfWater(real shape, real)
+{
+	return shape;
+}
+
+real terrainSdfNavigation(real shape, real elevationRaw)
+{
+	return combineNavigation(shape, elevationRaw);
+}
+
+void terrainSdfElevation(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	ctx->kernels->elevationBatch(ctx->noises, x, y, z, result);
+	validateBatch(result, "invalid elevation sdf value");
+}
+
+void terrainSdfElevationRaw(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	ctx->kernels->elevationRawBatch(ctx->noises, x, y, z, result);
+	validateBatch(result, "invalid elevation raw sdf value");
+}
+
+void terrainSdfLand(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	ctx->kernels->landBatch(ctx->noises, x, y, z, result);
+	validateBatch(result, "invalid land sdf value");
+}
+
+void terrainSdfWater(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	ctx->kernels->waterBatch(ctx->noises, x, y, z, result);
+	validateBatch(result, "invalid water sdf value");
+}
+
+void terrainSdfNavigation(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> result)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	ctx->kernels->navigationBatch(ctx->noises, x, y, z, result);
+	validateBatch(result, "invalid navigation sdf value");
+}
+
+void terrainSdfDensities(const TerrainContext *context, PointerRange<const real> x, PointerRange<const real> y, PointerRange<const real> z, PointerRange<real> shapes, PointerRange<real> elevationsRaw)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	ctx->kernels->densitiesBatch(ctx->noises, x, y, z, shapes, elevationsRaw);
+	validateBatch(shapes, "invalid water sdf value");
+	validateBatch(elevationsRaw, "invalid elevation raw sdf value");
+}
+
+real terrainSdfDisplacementBound(const TerrainContext *context)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	CAGE_ASSERT(ctx->bound > 0);
+	return ctx->bound / meshElevationRatio;
+}
+
+void terrainSdfBenchmark(const TerrainContext *context)
+{
+	const TerrainElevationContext *ctx = elevationContext(context);
+	constexpr uint32 count = 1000000;
+	std::vector<real> xs, ys, zs, results;
+	xs.reserve(count);
+	ys.reserve(count);
+	zs.reserve(count);
+	results.resize(count);
+	RandomGenerator rnd = seededRandom("benchmark");
+	for (uint32 i = 0; i < count; i++)
+	{
+		const vec3 p = rnd.randomRange3(-1500, 1500);
+		xs.push_back(p[0]);
+		ys.push_back(p[1]);
+		zs.push_back(p[2]);
+	}
+
+	const auto measure = [&](const char *name, auto &&fnc) {
+		const auto start = std::chrono::steady_clock::now();
+		fnc();
+		const uint64 duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		real sum = 0;
+		for (real r : results)
+			sum += r;
+		CAGE_LOG(SeverityEnum::Info, "benchmark", stringizer() + name + ": " + duration / 1000 + " ms, checksum: " + sum);
+	};
+
+	CAGE_LOG(SeverityEnum::Info, "benchmark", stringizer() + "land sdf of " + count + " samples, shape mode: '" + (string)configShapeMode + "', elevation mode: '" + (string)configElevationMode + "'");
+	if (ctx->shape)
+	{
+		// shape and elevation through separate function pointers, as before the kernels
+		measure("function pointers", [&]() {
+			for (uint32 i = 0; i < count; i++)
+			{
+				const vec3 p = vec3(xs[i], ys[i], zs[i]);
+				results[i] = combineLand(ctx->shape(p), ctx->elevation(ctx->noises, p));
+			}
+		});
+	}
+	measure("scalar kernel", [&]() {
+		for (uint32 i = 0; i < count; i++)
+			results[i] = ctx->kernels->land(ctx->noises, vec3(xs[i], ys[i], zs[i]));
+	});
+	measure("batch kernel", [&]() {
+		ctx->kernels->landBatch(ctx->noises, xs, ys, zs, results);
+	});
 }
 
 void terrainApplyConfig()
 {
-	chooseShapeFunction();
-	chooseElevationFunction();
+	string shape = configShapeMode;
+	if (shape == "random")
+	{
+		configShapeMode = shape = shapeModeNames[seededRandom("shape").randomRange(0u, shapeModesCount)];
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "randomly chosen shape mode: '" + shape + "'");
+	}
+	else
+	{
+		findShapeMode(shape);
+		CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "using shape mode: '" + shape + "'");
+	}
+	findElevationMode(configElevationMode);
+	CAGE_LOG(SeverityEnum::Info, "configuration", stringizer() + "using elevation mode: '" + (string)configElevationMode + "'");
 }
@@ -1,17 +1,23 @@
 #include <cage-core/noiseFunction.h>
 #include <cage-core/color.h>
-#include <cage-core/random.h>
 #include <cage-core/geometry.h>
 #include <cage-core/config.h>
+#include <cage-core/tasks.h>
 
 #include "voronoi.h"
-#include "terrain.h"
+#include "terrainContext.h"
 #include "generator.h"
 #include "math.h"
+#include "trace.h"
+
+#include <vector>
 
 namespace
 {
 	ConfigBool configPolesEnable("unnatural-planets/poles/enable");
+	ConfigBool configClimateBake("unnatural-planets/climate/bake", true);
+	ConfigFloat configClimateTemperatureError("unnatural-planets/climate/temperatureError", 1); // °C
+	ConfigFloat configClimatePrecipitationError("unnatural-planets/climate/precipitationError", 20); // cm
 
 	// returns zero when the slope is at or above the threshold plus the smoothing,
 	// returns one when the slope is at or below the threshold minus the smoothing
@@ -28,168 +34,332 @@ namespace
 		return saturate((value - lowest) / (highest - lowest));
 	}
 
-	void generateElevation(Tile &tile)
+	struct ElevationLayer
 	{
-		static const Holder<NoiseFunction> elevNoise = []() {
+		const Holder<NoiseFunction> elevNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::None;
 			cfg.frequency = 0.1;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateElevation/elevNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> maskNoise = []() {
+		const Holder<NoiseFunction> maskNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::None;
 			cfg.frequency = 0.005;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateElevation/maskNoise");
 			return newNoiseFunction(cfg);
 		}();
-		real p = elevNoise->evaluate(tile.position);
-		real m = maskNoise->evaluate(tile.position);
-		m = 1 - smootherstep(abs(m));
-		tile.elevation += p * m * 30;
-	}
 
-	void generatePrecipitation(Tile &tile)
+		void generate(Tile &tile) const
+		{
+			real p = elevNoise->evaluate(tile.position);
+			real m = maskNoise->evaluate(tile.position);
+			m = 1 - smootherstep(abs(m));
+			tile.elevation += p * m * 30;
+		}
+	};
+
+	struct PrecipitationLayer
 	{
-		static const Holder<NoiseFunction> precpNoise = []() {
+		const Holder<NoiseFunction> precpNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.0015;
-			cfg.seed = noiseSeed();
-			return newNoiseFunction(cfg);
-		}();
-		real p = precpNoise->evaluate(tile.position) * 0.5 + 0.5;
-		p = saturate(p);
-		p = smootherstep(p);
-		p = smootherstep(p);
-		p = smootherstep(p);
-		p = pow(p, 1.5);
-		p += max(120 - abs(tile.elevation), 0) * 0.002; // more water close to oceans
-		p = max(p - 0.02, 0);
-		tile.precipitation = p * 400;
-	}
+			cfg.seed = noiseSeed("generatePrecipitation/precpNoise");
+			return newNoiseFunction(cfg);
+		}();
+
+		// the part that depends on the noise only
+		static real base(real noise)
+		{
+			real p = noise * 0.5 + 0.5;
+			p = saturate(p);
+			p = smootherstep(p);
+			p = smootherstep(p);
+			p = smootherstep(p);
+			return pow(p, 1.5);
+		}
+
+		void generate(Tile &tile, real noise) const
+		{
+			real p = base(noise);
+			p += max(120 - abs(tile.elevation), 0) * 0.002; // more water close to oceans
+			p = max(p - 0.02, 0);
+			tile.precipitation = p * 400;
+		}
+	};
 
-	void generateTemperature(Tile &tile)
+	struct TemperatureLayer
 	{
-		static const Holder<NoiseFunction> tempNoise = []() {
+		const Holder<NoiseFunction> tempNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Simplex;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 5;
 			cfg.gain = 0.4;
 			cfg.frequency = 0.00065;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateTemperature/tempNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> polarNoise = []() {
+		const Holder<NoiseFunction> polarNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Value;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.007;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateTemperature/polarNoise");
 			return newNoiseFunction(cfg);
 		}();
+		const bool polesEnable = configPolesEnable;
 
-		real t = tempNoise->evaluate(tile.position) * 0.5 + 0.5;
-		t = saturate(t);
-		t = smoothstep(t);
-		t = t * 2 - 1;
+		// the part that depends on the noise only
+		static real base(real noise)
+		{
+			real t = noise * 0.5 + 0.5;
+			t = saturate(t);
+			t = smoothstep(t);
+			return t * 2 - 1;
+		}
 
-		if (configPolesEnable)
+		void generate(Tile &tile, real noise) const
 		{
-			real polar = abs(atan(tile.position[1] / length(vec2(tile.position[0], tile.position[2]))).value) / real::Pi() * 2;
-			polar = pow(polar, 1.7);
-			polar += polarNoise->evaluate(tile.position) * 0.1;
-			t += 0.6 - polar * 3.2;
+			real t = base(noise);
+
+			if (polesEnable)
+			{
+				real polar = abs(atan(tile.position[1] / length(vec2(tile.position[0], tile.position[2]))).value) / real::Pi() * 2;
+				polar = pow(polar, 1.7);
+				polar += polarNoise->evaluate(tile.position) * 0.1;
+				t += 0.6 - polar * 3.2;
+			}
+
+			tile.temperature = 15 + t * 30 - max(tile.elevation, 0) * 0.02;
 		}
+	};
 
-		tile.temperature = 15 + t * 30 - max(tile.elevation, 0) * 0.02;
-	}
+	// the temperature and precipitation noises are very smooth, they are sampled once on a coarse grid and interpolated
+	// the resolution is doubled until the interpolation error is within the configured bounds
+	struct ClimateGrid
+	{
+		static constexpr float BoxMargin = 50; // the tiles and texels may lie slightly outside the mesh generation box, eg. the slope samples
+		static constexpr float BoxSize = terrainBoxSize + BoxMargin * 2;
+		static constexpr uint32 InitialResolution = 40;
+		static constexpr uint32 MaxResolution = 160;
+		static constexpr uint32 ValidationSamples = 1000;
+		static constexpr uint32 ValidationBatch = 1024;
+		static constexpr uint32 ValidationAttempts = 200; // batches of candidates
+		static constexpr float ValidationBand = 30; // distance from the surface
+
+		const TemperatureLayer &temperature;
+		const PrecipitationLayer &precipitation;
+		std::vector<vec2> values; // temperature and precipitation noise
+		std::vector<vec3> validationPoints;
+		uint32 resolution = 0;
+		real spacing = 0;
+
+		vec2 evaluate(const vec3 &position) const
+		{
+			return vec2(temperature.tempNoise->evaluate(position), precipitation.precpNoise->evaluate(position));
+		}
+
+		vec3 gridPosition(uint32 x, uint32 y, uint32 z) const
+		{
+			return vec3(x, y, z) * spacing - BoxSize * 0.5;
+		}
+
+		void sliceEntry(uint32 z)
+		{
+			vec2 *v = values.data() + z * resolution * resolution;
+			for (uint32 y = 0; y < resolution; y++)
+				for (uint32 x = 0; x < resolution; x++)
+					*v++ = evaluate(gridPosition(x, y, z));
+		}
 
-	void generateWater(Tile &tile)
+		vec2 lookup(const vec3 &position) const
+		{
+			const vec3 g = clamp((position + BoxSize * 0.5) / spacing, 0, resolution - 1.001);
+			const ivec3 i = ivec3(g);
+			const vec3 f = g - vec3(i);
+			const auto &at = [&](uint32 x, uint32 y, uint32 z) { return values[((i[2] + z) * resolution + i[1] + y) * resolution + i[0] + x]; };
+			const vec2 x00 = interpolate(at(0, 0, 0), at(1, 0, 0), f[0]);
+			const vec2 x10 = interpolate(at(0, 1, 0), at(1, 1, 0), f[0]);
+			const vec2 x01 = interpolate(at(0, 0, 1), at(1, 0, 1), f[0]);
+			const vec2 x11 = interpolate(at(0, 1, 1), at(1, 1, 1), f[0]);
+			return interpolate(interpolate(x00, x10, f[1]), interpolate(x01, x11, f[1]), f[2]);
+		}
+
+		// maximum differences of the temperature and precipitation caused by the interpolation
+		vec2 measureErrors() const
+		{
+			vec2 errors;
+			for (const vec3 &p : validationPoints)
+			{
+				const vec2 a = evaluate(p);
+				const vec2 b = lookup(p);
+				errors[0] = max(errors[0], abs(TemperatureLayer::base(a[0]) - TemperatureLayer::base(b[0])) * 30);
+				errors[1] = max(errors[1], abs(PrecipitationLayer::base(a[1]) - PrecipitationLayer::base(b[1])) * 400);
+			}
+			return errors;
+		}
+
+		// the climate is used on the surfaces only, most of the box is empty space
+		// random points are kept if they are close to the land or the water surface
+		void generateValidationPoints(const TerrainContext *context)
+		{
+			RandomGenerator rng = seededRandom("climateValidation");
+			real xs[ValidationBatch], ys[ValidationBatch], zs[ValidationBatch], shapes[ValidationBatch], elevations[ValidationBatch];
+			validationPoints.reserve(ValidationSamples);
+			for (uint32 attempt = 0; attempt < ValidationAttempts && validationPoints.size() < ValidationSamples; attempt++)
+			{
+				for (uint32 i = 0; i < ValidationBatch; i++)
+				{
+					const vec3 p = rng.randomRange3(-terrainBoxSize * 0.5, terrainBoxSize * 0.5);
+					xs[i] = p[0];
+					ys[i] = p[1];
+					zs[i] = p[2];
+				}
+				terrainSdfDensities(context, { xs, xs + ValidationBatch }, { ys, ys + ValidationBatch }, { zs, zs + ValidationBatch }, { shapes, shapes + ValidationBatch }, { elevations, elevations + ValidationBatch });
+				for (uint32 i = 0; i < ValidationBatch && validationPoints.size() < ValidationSamples; i++)
+				{
+					const real land = terrainSdfLand(shapes[i], elevations[i]);
+					const real water = terrainSdfWater(shapes[i], elevations[i]);
+					if (min(abs(land), abs(water)) < ValidationBand)
+						validationPoints.push_back(vec3(xs[i], ys[i], zs[i]));
+				}
+			}
+			if (validationPoints.size() < ValidationSamples)
+				CAGE_LOG(SeverityEnum::Warning, "generator", stringizer() + "found only " + numeric_cast<uint32>(validationPoints.size()) + " climate validation points near the surface");
+		}
+
+		ClimateGrid(const TerrainContext *context, const TemperatureLayer &temperature, const PrecipitationLayer &precipitation) : temperature(temperature), precipitation(precipitation)
+		{
+			if (!configClimateBake)
+				return;
+			TraceScope trace("climate bake");
+			generateValidationPoints(context);
+			if (validationPoints.empty())
+			{
+				CAGE_LOG(SeverityEnum::Info, "generator", "no climate validation points, evaluating climate directly");
+				return;
+			}
+			const real temperatureBound = (float)configClimateTemperatureError;
+			const real precipitationBound = (float)configClimatePrecipitationError;
+			for (resolution = InitialResolution; ; resolution *= 2)
+			{
+				spacing = BoxSize / (resolution - 1);
+				values.resize(resolution * resolution * resolution);
+				tasksRun(Delegate<void(uint32)>().bind<ClimateGrid, &ClimateGrid::sliceEntry>(this), resolution);
+				const vec2 errors = measureErrors();
+				if (errors[0] <= temperatureBound && errors[1] <= precipitationBound)
+				{
+					CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "climate grid resolution: " + resolution + ", temperature error: " + errors[0] + " C, precipitation error: " + errors[1] + " cm");
+					break;
+				}
+				if (resolution * 2 > MaxResolution)
+				{
+					CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "climate grid is not precise enough, temperature error: " + errors[0] + " C, precipitation error: " + errors[1] + " cm, evaluating climate directly");
+					values.clear();
+					resolution = 0;
+					break;
+				}
+			}
+		}
+
+		// temperature and precipitation noise, interpolated when the grid is available
+		vec2 sample(const vec3 &position) const
+		{
+			if (resolution == 0)
+				return evaluate(position);
+			return lookup(position);
+		}
+	};
+
+	struct WaterLayer
 	{
-		static const Holder<NoiseFunction> hueNoise = []() {
+		const Holder<NoiseFunction> hueNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.01;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateWater/hueNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> xNoise = []() {
+		const Holder<NoiseFunction> xNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Value;
 			cfg.frequency = 0.001;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateWater/xNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> yNoise = []() {
+		const Holder<NoiseFunction> yNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Value;
 			cfg.frequency = 0.001;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateWater/yNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> zNoise = []() {
+		const Holder<NoiseFunction> zNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Value;
 			cfg.frequency = 0.001;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateWater/zNoise");
 			return newNoiseFunction(cfg);
 		}();
 
-		real shallow = rangeMask(tile.elevation, -20, 3);
-		shallow = smoothstep(shallow);
-		real hueShift = hueNoise->evaluate(tile.position) * 0.06;
-		vec3 color = colorHueShift(interpolate(vec3(54, 54, 97), vec3(26, 102, 125), shallow) / 255, hueShift);
-
-		tile.albedo = color;
-		tile.roughness = 0.3;
-		tile.metallic = 0;
-
-		{ // waves
-			real x = xNoise->evaluate(tile.position);
-			real y = yNoise->evaluate(tile.position);
-			real z = zNoise->evaluate(tile.position);
-			vec3 dir = normalize(vec3(x, y, z));
-			CAGE_ASSERT(isUnit(dir));
-			real dist = dot(dir, tile.position) * length(tile.position);
-			rads a = rads(dist * 0.002);
-			rads b = rads(sin(a + sin(a) * 0.5)); // skewed wave
-			real c = sin(b + sin(b) * 0.5);
-			real wave = c * (1 - shallow * 0.9) * 0.1 + 0.5;
-			tile.height = wave;
-		}
-
+		void generate(Tile &tile) const
 		{
-			real d1 = 1 - sqr(rangeMask(tile.elevation, -10, 3)); // softer clip through terrain
-			real d2 = rescale(rangeMask(tile.elevation, 0, -200), 0, 1, 0.7, 0.95); // shallower water is more translucent
-			tile.opacity = d1 * d2;
-		}
+			real shallow = rangeMask(tile.elevation, -20, 3);
+			shallow = smoothstep(shallow);
+			real hueShift = hueNoise->evaluate(tile.position) * 0.06;
+			vec3 color = colorHueShift(interpolate(vec3(54, 54, 97), vec3(26, 102, 125), shallow) / 255, hueShift);
+
+			tile.albedo = color;
+			tile.roughness = 0.3;
+			tile.metallic = 0;
+
+			{ // waves
+				real x = xNoise->evaluate(tile.position);
+				real y = yNoise->evaluate(tile.position);
+				real z = zNoise->evaluate(tile.position);
+				vec3 dir = normalize(vec3(x, y, z));
+				CAGE_ASSERT(isUnit(dir));
+				real dist = dot(dir, tile.position) * length(tile.position);
+				rads a = rads(dist * 0.002);
+				rads b = rads(sin(a + sin(a) * 0.5)); // skewed wave
+				real c = sin(b + sin(b) * 0.5);
+				real wave = c * (1 - shallow * 0.9) * 0.1 + 0.5;
+				tile.height = wave;
+			}
+
+			{
+				real d1 = 1 - sqr(rangeMask(tile.elevation, -10, 3)); // softer clip through terrain
+				real d2 = rescale(rangeMask(tile.elevation, 0, -200), 0, 1, 0.7, 0.95); // shallower water is more translucent
+				tile.opacity = d1 * d2;
+			}
 
-		tile.biome = TerrainBiomeEnum::Water;
-		tile.type = shallow > 0.5 ? TerrainTypeEnum::ShallowWater : TerrainTypeEnum::DeepWater;
-	}
+			tile.biome = TerrainBiomeEnum::Water;
+			tile.type = shallow > 0.5 ? TerrainTypeEnum::ShallowWater : TerrainTypeEnum::DeepWater;
+		}
+	};
 
-	void generateIce(Tile &tile)
+	struct IceLayer
 	{
-		static const Holder<NoiseFunction> scaleNoise = []() {
+		const Holder<NoiseFunction> scaleNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Value;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.03;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateIce/scaleNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> cracksNoise = []() {
+		const Holder<NoiseFunction> cracksNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cellular;
 			cfg.distance = NoiseDistanceEnum::Hybrid;
@@ -197,66 +367,101 @@ namespace
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 3;
 			cfg.frequency = 0.1;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateIce/cracksNoise");
 			return newNoiseFunction(cfg);
 		}();
 
-		real bf = sharpEdge(rangeMask(tile.temperature, 0, -3));
-		if (bf < 1e-7)
-			return;
+		void generate(Tile &tile) const
+		{
+			real bf = sharpEdge(rangeMask(tile.temperature, 0, -3));
+			if (bf < 1e-7)
+				return;
+
+			real scale = scaleNoise->evaluate(tile.position) * 0.02 + 0.5;
+			real crack = cracksNoise->evaluate(tile.position * scale) * 0.5 + 0.5;
+			crack = pow(crack, 0.3);
+			vec3 color = vec3(61, 81, 82) / 255 + crack * 0.3;
+			real roughness = (1 - crack) * 0.6 + 0.15;
+			real metallic = 0;
+			real height = crack * 0.2 + 0.4;
+
+			tile.albedo = interpolate(tile.albedo, color, bf);
+			tile.roughness = interpolate(tile.roughness, roughness, bf);
+			tile.metallic = interpolate(tile.metallic, metallic, bf);
+			tile.height = interpolate(tile.height, height, bf);
+			tile.opacity = interpolate(tile.opacity, tile.opacity + 0.1, bf);
+
+			if (bf > 0.1)
+			{
+				tile.biome = TerrainBiomeEnum::Bare;
+				if (tile.type != TerrainTypeEnum::SteepSlope)
+					tile.type = TerrainTypeEnum::Slow;
+			}
+		}
+	};
 
-		real scale = scaleNoise->evaluate(tile.position) * 0.02 + 0.5;
-		real crack = cracksNoise->evaluate(tile.position * scale) * 0.5 + 0.5;
-		crack = pow(crack, 0.3);
-		vec3 color = vec3(61, 81, 82) / 255 + crack * 0.3;
-		real roughness = (1 - crack) * 0.6 + 0.15;
-		real metallic = 0;
-		real height = crack * 0.2 + 0.4;
+	constexpr real slopeRadius = 0.5;
 
-		tile.albedo = interpolate(tile.albedo, color, bf);
-		tile.roughness = interpolate(tile.roughness, roughness, bf);
-		tile.metallic = interpolate(tile.metallic, metallic, bf);
-		tile.height = interpolate(tile.height, height, bf);
-		tile.opacity = interpolate(tile.opacity, tile.opacity + 0.1, bf);
+	// offsets of the four slope samples, along two tangents of the tile
+	void slopeOffsets(const Tile &tile, vec3 offsets[4])
+	{
+		const vec3 a = anyPerpendicular(tile.normal);
+		const vec3 b = cross(tile.normal, a);
+		offsets[0] = a * slopeRadius;
+		offsets[1] = b * slopeRadius;
+		offsets[2] = -a * slopeRadius;
+		offsets[3] = -b * slopeRadius;
+	}
 
-		if (bf > 0.1)
-		{
-			tile.biome = TerrainBiomeEnum::Bare;
-			if (tile.type != TerrainTypeEnum::SteepSlope)
-				tile.type = TerrainTypeEnum::Slow;
-		}
+	// central differences along two tangents, the gradient is projected into the surface
+	// the elevations at the slope offsets are evaluated by the caller, together with the other tiles
+	void generateSlope(Tile &tile, const real elevs[4])
+	{
+		constexpr real radius = slopeRadius;
+		const vec3 a = anyPerpendicular(tile.normal);
+		const vec3 b = cross(tile.normal, a);
+		tile.gradient = (a * (elevs[0] - elevs[2]) + b * (elevs[1] - elevs[3])) / (2 * radius);
+		// same scale as the elevation difference across the whole diameter used previously
+		tile.slope = atan(length(tile.gradient) * 0.2);
 	}
 
-	void generateSlope(Tile &tile)
+#ifdef CAGE_DEBUG
+	// compare with the range of elevations on a circle
+	void validateSlope(const TerrainContext *context, const Tile &tile)
 	{
-		constexpr real radius = 0.5;
-		vec3 a = anyPerpendicular(tile.normal);
-		vec3 b = cross(tile.normal, a);
-		a *= radius;
-		b *= radius;
+		constexpr real radius = slopeRadius;
+		vec3 offsets[4];
+		slopeOffsets(tile, offsets);
+		const vec3 a = offsets[0] / radius;
+		const vec3 b = offsets[1] / radius;
 		const real div = 1 / sqrt(2);
-		vec3 c = (a + b) * div;
-		vec3 d = (a - b) * div;
-		real elevs[8] = {
-			terrainSdfElevation(tile.position + a),
-			terrainSdfElevation(tile.position + b),
-			terrainSdfElevation(tile.position - a),
-			terrainSdfElevation(tile.position - b),
-			terrainSdfElevation(tile.position + c),
-			terrainSdfElevation(tile.position + d),
-			terrainSdfElevation(tile.position - c),
-			terrainSdfElevation(tile.position - d),
-		};
-		real e1 = elevs[0];
-		real e2 = elevs[0];
-		for (real e : elevs)
+		const vec3 c = (a + b) * div * radius;
+		const vec3 d = (a - b) * div * radius;
+		const vec3 samples[9] = { vec3(), offsets[0], offsets[1], c, d, offsets[2], offsets[3], -c, -d };
+		real e[9];
+		for (uint32 i = 0; i < 9; i++)
+			e[i] = terrainSdfElevation(context, tile.position + samples[i]);
+		real e1 = e[1], e2 = e[1], q1 = real::Infinity(), q2 = -real::Infinity();
+		for (uint32 i = 1; i < 9; i++)
 		{
-			e1 = min(e1, e);
-			e2 = max(e2, e);
+			e1 = min(e1, e[i]);
+			e2 = max(e2, e[i]);
 		}
-		real md = (e2 - e1) * 0.1;
-		tile.slope = atan(md / radius);
+		for (uint32 i = 1; i < 5; i++)
+		{
+			const real q = (e[i] + e[i + 4]) * 0.5 - e[0]; // curvature along the diameter
+			q1 = min(q1, q);
+			q2 = max(q2, q);
+		}
+		const rads reference = atan((e2 - e1) * 0.1 / radius);
+		// on a quadratic field, the range is at least the difference along the diameter closest to the gradient, and at most the full difference plus the spread of the curvatures
+		const real span = length(tile.gradient) * 2 * radius;
+		const rads lower = atan(max(span * cos(degs(22.5)) * 0.9 - 0.05, 0) * 0.1 / radius);
+		const rads upper = atan((span * 1.1 + q2 - q1 + 0.05) * 0.1 / radius);
+		const rads margin = degs(1);
+		CAGE_ASSERT(reference > lower - margin && reference < upper + margin);
 	}
+#endif // CAGE_DEBUG
 
 	void generateBiome(Tile &tile)
 	{
@@ -327,28 +532,28 @@ namespace
 		}
 	}
 
-	void generateBedrock(Tile &tile)
+	struct BedrockLayer
 	{
-		static const uint32 seed = noiseSeed();
-		static const Holder<NoiseFunction> scaleNoise = []() {
+		const uint32 seed = noiseSeed("generateBedrock/seed");
+		const Holder<NoiseFunction> scaleNoise = [&]() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.05;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateBedrock/scaleNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> freqNoise = []() {
+		const Holder<NoiseFunction> freqNoise = [&]() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.005;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateBedrock/freqNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> cracksNoise = []() {
+		const Holder<NoiseFunction> cracksNoise = [&]() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cellular;
 			cfg.distance = NoiseDistanceEnum::Hybrid;
@@ -358,7 +563,7 @@ namespace
 			cfg.seed = seed;
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> valueNoise = []() {
+		const Holder<NoiseFunction> valueNoise = [&]() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cellular;
 			cfg.distance = NoiseDistanceEnum::Hybrid;
@@ -368,28 +573,31 @@ namespace
 			cfg.seed = seed;
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> saturationNoise = []() {
+		const Holder<NoiseFunction> saturationNoise = [&]() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.003;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateBedrock/saturationNoise");
 			return newNoiseFunction(cfg);
 		}();
 
-		real scale = scaleNoise->evaluate(tile.position) * 0.5 + 0.501;
-		scale = sqr(scale) * 2;
-		real freq = freqNoise->evaluate(tile.position) * 0.05 + 0.15;
-		real cracks = cracksNoise->evaluate(tile.position * freq) * 0.5 + 0.5;
-		cracks = saturate(pow(cracks, 0.8));
-		real value = valueNoise->evaluate(tile.position * freq) * 0.5 + 0.5;
-		real saturation = saturationNoise->evaluate(tile.position) * 0.5 + 0.5;
-		vec3 hsv = vec3(0.07, saturate(sharpEdge(saturation, 0.2)), (value * 0.6 + 0.2) * cracks);
-		tile.albedo = colorHsvToRgb(hsv);
-		tile.roughness = interpolate(0.9, value * 0.2 + 0.7, cracks);
-		tile.height = cracks * scale;
-	}
+		void generate(Tile &tile) const
+		{
+			real scale = scaleNoise->evaluate(tile.position) * 0.5 + 0.501;
+			scale = sqr(scale) * 2;
+			real freq = freqNoise->evaluate(tile.position) * 0.05 + 0.15;
+			real cracks = cracksNoise->evaluate(tile.position * freq) * 0.5 + 0.5;
+			cracks = saturate(pow(cracks, 0.8));
+			real value = valueNoise->evaluate(tile.position * freq) * 0.5 + 0.5;
+			real saturation = saturationNoise->evaluate(tile.position) * 0.5 + 0.5;
+			vec3 hsv = vec3(0.07, saturate(sharpEdge(saturation, 0.2)), (value * 0.6 + 0.2) * cracks);
+			tile.albedo = colorHsvToRgb(hsv);
+			tile.roughness = interpolate(0.9, value * 0.2 + 0.7, cracks);
+			tile.height = cracks * scale;
+		}
+	};
 
 	void generateCliffs(Tile &tile)
 	{
@@ -403,9 +611,9 @@ namespace
 		color = colorHsvToRgb(hsv);
 	}
 
-	void generateMica(Tile &tile)
+	struct MicaLayer
 	{
-		static const Holder<NoiseFunction> maskNoise = []() {
+		const Holder<NoiseFunction> maskNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cellular;
 			cfg.distance = NoiseDistanceEnum::Hybrid;
@@ -413,39 +621,42 @@ namespace
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 3;
 			cfg.frequency = 0.1;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateMica/maskNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> cracksNoise = []() {
+		const Holder<NoiseFunction> cracksNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cellular;
 			cfg.distance = NoiseDistanceEnum::Manhattan;
 			cfg.operation = NoiseOperationEnum::Divide;
 			cfg.fractalType = NoiseFractalTypeEnum::None;
 			cfg.frequency = 0.3;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateMica/cracksNoise");
 			return newNoiseFunction(cfg);
 		}();
 
-		real bf = saturate((maskNoise->evaluate(tile.position) - 1) * 10);
-		if (bf < 1e-7)
-			return;
-
-		real cracks = sharpEdge(saturate((cracksNoise->evaluate(tile.position) + 0.6)));
-		vec3 color = interpolate(vec3(122, 90, 88) / 255, vec3(184, 209, 187) / 255, cracks);
-		real roughness = cracks * 0.3 + 0.5;
-		real metallic = 1;
-		real height = tile.height - 0.05;
-
-		tile.albedo = interpolate(tile.albedo, color, bf);
-		tile.roughness = interpolate(tile.roughness, roughness, bf);
-		tile.metallic = interpolate(tile.metallic, metallic, bf);
-		tile.height = interpolate(tile.height, height, bf);
-	}
+		void generate(Tile &tile) const
+		{
+			real bf = saturate((maskNoise->evaluate(tile.position) - 1) * 10);
+			if (bf < 1e-7)
+				return;
+
+			real cracks = sharpEdge(saturate((cracksNoise->evaluate(tile.position) + 0.6)));
+			vec3 color = interpolate(vec3(122, 90, 88) / 255, vec3(184, 209, 187) / 255, cracks);
+			real roughness = cracks * 0.3 + 0.5;
+			real metallic = 1;
+			real height = tile.height - 0.05;
+
+			tile.albedo = interpolate(tile.albedo, color, bf);
+			tile.roughness = interpolate(tile.roughness, roughness, bf);
+			tile.metallic = interpolate(tile.metallic, metallic, bf);
+			tile.height = interpolate(tile.height, height, bf);
+		}
+	};
 
-	void generateDirt(Tile &tile)
+	struct DirtLayer
 	{
-		static const Holder<NoiseFunction> heightNoise = []() {
+		const Holder<NoiseFunction> heightNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
@@ -453,304 +664,335 @@ namespace
 			cfg.lacunarity = 2.3;
 			cfg.gain = 0.4;
 			cfg.frequency = 0.05;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateDirt/heightNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> cracksNoise = []() {
+		const Holder<NoiseFunction> cracksNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::SimplexReduced;
 			cfg.fractalType = NoiseFractalTypeEnum::Ridged;
 			cfg.octaves = 2;
 			cfg.frequency = 0.07;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateDirt/cracksNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> cracksMaskNoise = []() {
+		const Holder<NoiseFunction> cracksMaskNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.02;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateDirt/cracksMaskNoise");
 			return newNoiseFunction(cfg);
 		}();
+		const uint32 roughnessSeed = noiseSeed("generateDirt/roughness");
 
-		real height = heightNoise->evaluate(tile.position) * 0.2 + 0.5;
-		real bf = sharpEdge(saturate(height - tile.height + 0.4)) * steepnessMask(tile.slope, degs(20));
-		if (bf < 1e-7)
-			return;
-
-		vec3 color = vec3(84, 47, 14) / 255;
+		void generate(Tile &tile) const
 		{
-			real saturation = rangeMask(tile.precipitation, 0, 50);
-			vec3 hsv = colorRgbToHsv(color);
-			hsv[1] *= saturation;
-			color = colorHsvToRgb(hsv);
-		}
-		real roughness = randomChance() * 0.1 + 0.7;
-		real metallic = 0;
-
-		{ // cracks
-			real cracks = sharpEdge(saturate(cracksNoise->evaluate(tile.position) * 2 - 1.2), 0.15);
-			cracks *= sqr(smoothstep(saturate(cracksMaskNoise->evaluate(tile.position) * 0.5 + 0.5))) * 0.9 + 0.1;
-			cracks *= rangeMask(tile.precipitation, 70, 20) * 0.9 + 0.1;
-			height = interpolate(height, height * 0.5, cracks);
-			color = interpolate(color, vec3(0.1), cracks);
-			roughness = interpolate(roughness, 0.9, cracks);
+			const real steepness = steepnessMask(tile.slope, degs(20));
+			if (steepness < 1e-7)
+				return;
+
+			real height = heightNoise->evaluate(tile.position) * 0.2 + 0.5;
+			real bf = sharpEdge(saturate(height - tile.height + 0.4)) * steepness;
+			if (bf < 1e-7)
+				return;
+
+			vec3 color = vec3(84, 47, 14) / 255;
+			{
+				real saturation = rangeMask(tile.precipitation, 0, 50);
+				vec3 hsv = colorRgbToHsv(color);
+				hsv[1] *= saturation;
+				color = colorHsvToRgb(hsv);
+			}
+			real roughness = positionRandom(tile.position, roughnessSeed) * 0.1 + 0.7;
+			real metallic = 0;
+
+			{ // cracks
+				real cracks = sharpEdge(saturate(cracksNoise->evaluate(tile.position) * 2 - 1.2), 0.15);
+				cracks *= sqr(smoothstep(saturate(cracksMaskNoise->evaluate(tile.position) * 0.5 + 0.5))) * 0.9 + 0.1;
+				cracks *= rangeMask(tile.precipitation, 70, 20) * 0.9 + 0.1;
+				height = interpolate(height, height * 0.5, cracks);
+				color = interpolate(color, vec3(0.1), cracks);
+				roughness = interpolate(roughness, 0.9, cracks);
+			}
+
+			tile.albedo = interpolate(tile.albedo, color, bf);
+			tile.roughness = interpolate(tile.roughness, roughness, bf);
+			tile.metallic = interpolate(tile.metallic, metallic, bf);
+			tile.height = interpolate(tile.height, height, bf);
 		}
+	};
 
-		tile.albedo = interpolate(tile.albedo, color, bf);
-		tile.roughness = interpolate(tile.roughness, roughness, bf);
-		tile.metallic = interpolate(tile.metallic, metallic, bf);
-		tile.height = interpolate(tile.height, height, bf);
-	}
-
-	void generateSand(Tile &tile)
+	struct SandLayer
 	{
-		static const Holder<NoiseFunction> heightNoise = []() {
+		const Holder<NoiseFunction> heightNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Simplex;
 			cfg.fractalType = NoiseFractalTypeEnum::Ridged;
 			cfg.octaves = 3;
 			cfg.gain = 0.7;
 			cfg.frequency = 0.01;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateSand/heightNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> hueNoise = []() {
+		const Holder<NoiseFunction> hueNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 4;
 			cfg.frequency = 0.01;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateSand/hueNoise");
 			return newNoiseFunction(cfg);
 		}();
+		const uint32 colorSeed = noiseSeed("generateSand/color");
+		const uint32 roughnessSeed = noiseSeed("generateSand/roughness");
 
-		real bf = rangeMask(tile.temperature, 24, 28) * steepnessMask(tile.slope, degs(19));
-		if (bf < 1e-7)
-			return;
+		static real mask(const Tile &tile)
+		{
+			return rangeMask(tile.temperature, 24, 28) * steepnessMask(tile.slope, degs(19));
+		}
 
-		real height = heightNoise->evaluate(tile.position) * 0.2;
-		height *= rangeMask(tile.precipitation, 100, 50) * 0.6 + 0.4;
-		height += 0.5;
-		real hueShift = hueNoise->evaluate(tile.position) * 0.1;
-		vec3 color = colorHueShift(vec3(172, 159, 139) / 255, hueShift);
-		color = colorDeviation(color, 0.08);
-		real roughness = randomChance() * 0.3 + 0.6;
-		real metallic = 0;
-
-		tile.albedo = interpolate(tile.albedo, color, bf);
-		tile.roughness = interpolate(tile.roughness, roughness, bf);
-		tile.metallic = interpolate(tile.metallic, metallic, bf);
-		tile.height = interpolate(tile.height, height, bf);
-	}
+		void generate(Tile &tile, real bf) const
+		{
+			if (bf < 1e-7)
+				return;
+
+			real height = heightNoise->evaluate(tile.position) * 0.2;
+			height *= rangeMask(tile.precipitation, 100, 50) * 0.6 + 0.4;
+			height += 0.5;
+			real hueShift = hueNoise->evaluate(tile.position) * 0.1;
+			vec3 color = colorHueShift(vec3(172, 159, 139) / 255, hueShift);
+			color = colorDeviation(color, tile.position, colorSeed, 0.08);
+			real roughness = positionRandom(tile.position, roughnessSeed) * 0.3 + 0.6;
+			real metallic = 0;
+
+			tile.albedo = interpolate(tile.albedo, color, bf);
+			tile.roughness = interpolate(tile.roughness, roughness, bf);
+			tile.metallic = interpolate(tile.metallic, metallic, bf);
+			tile.height = interpolate(tile.height, height, bf);
+		}
+	};
 
-	void generateGrass(Tile &tile)
+	struct GrassLayer
 	{
-		constexpr const auto bladesNoiseGen = []() {
+		static Holder<NoiseFunction> bladesNoiseGen(const char *key)
+		{
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cellular;
 			cfg.fractalType = NoiseFractalTypeEnum::None;
 			cfg.distance = NoiseDistanceEnum::EuclideanSq;
 			cfg.operation = NoiseOperationEnum::Divide;
 			cfg.frequency = 1.4;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed(key);
 			return newNoiseFunction(cfg);
+		}
+
+		const Holder<NoiseFunction> bladesNoise[3] = {
+			bladesNoiseGen("generateGrass/bladesNoise1"),
+			bladesNoiseGen("generateGrass/bladesNoise2"),
+			bladesNoiseGen("generateGrass/bladesNoise3"),
 		};
-		static const Holder<NoiseFunction> bladesNoise[] = {
-			bladesNoiseGen(),
-			bladesNoiseGen(),
-			bladesNoiseGen(),
-		};
-		static const Holder<NoiseFunction> hueNoise = []() {
+		const Holder<NoiseFunction> hueNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 2;
 			cfg.frequency = 0.05;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateGrass/hueNoise");
 			return newNoiseFunction(cfg);
 		}();
+		const uint32 roughnessSeed = noiseSeed("generateGrass/roughness");
 
-		if (tile.biome == TerrainBiomeEnum::Water)
-			return;
-
-		real bf = rangeMask(abs(tile.temperature - 13), 10, 7) * rangeMask(abs(tile.precipitation - 140), 90, 60) * steepnessMask(tile.slope, degs(30));
-		if (bf < 1e-7)
-			return;
-
-		real grass = 0;
-		for (uint32 i = 0; i < sizeof(bladesNoise) / sizeof(bladesNoise[0]); i++)
-			grass += sharpEdge(bladesNoise[i]->evaluate(tile.position) + 0.7);
-		bf *= saturate(grass);
-		if (bf < 1e-7)
-			return;
-
-		real height = tile.height + grass * 0.05;
-		real ratio = tile.temperature - (tile.precipitation + 100) * 30 / 400;
-		real hueShift = hueNoise->evaluate(tile.position) * 0.09 - max(ratio, 0) * 0.02;
-		vec3 color = colorHueShift(vec3(79, 114, 55) / 255, hueShift);
-		real roughness = randomChance() * 0.2 + 0.6 + min(ratio, 0) * 0.03;
-		real metallic = 0;
-
-		tile.albedo = interpolate(tile.albedo, color, bf);
-		tile.roughness = interpolate(tile.roughness, roughness, bf);
-		tile.metallic = interpolate(tile.metallic, metallic, bf);
-		tile.height = interpolate(tile.height, height, bf);
-	}
+		void generate(Tile &tile) const
+		{
+			if (tile.biome == TerrainBiomeEnum::Water)
+				return;
+
+			real bf = rangeMask(abs(tile.temperature - 13), 10, 7) * rangeMask(abs(tile.precipitation - 140), 90, 60) * steepnessMask(tile.slope, degs(30));
+			if (bf < 1e-7)
+				return;
+
+			real grass = 0;
+			for (uint32 i = 0; i < sizeof(bladesNoise) / sizeof(bladesNoise[0]); i++)
+				grass += sharpEdge(bladesNoise[i]->evaluate(tile.position) + 0.7);
+			bf *= saturate(grass);
+			if (bf < 1e-7)
+				return;
+
+			real height = tile.height + grass * 0.05;
+			real ratio = tile.temperature - (tile.precipitation + 100) * 30 / 400;
+			real hueShift = hueNoise->evaluate(tile.position) * 0.09 - max(ratio, 0) * 0.02;
+			vec3 color = colorHueShift(vec3(79, 114, 55) / 255, hueShift);
+			real roughness = positionRandom(tile.position, roughnessSeed) * 0.2 + 0.6 + min(ratio, 0) * 0.03;
+			real metallic = 0;
+
+			tile.albedo = interpolate(tile.albedo, color, bf);
+			tile.roughness = interpolate(tile.roughness, roughness, bf);
+			tile.metallic = interpolate(tile.metallic, metallic, bf);
+			tile.height = interpolate(tile.height, height, bf);
+		}
+	};
 
-	void generateBoulders(Tile &tile)
+	struct BouldersLayer
 	{
-		static const Holder<NoiseFunction> thresholdNoise = []() {
+		const Holder<NoiseFunction> thresholdNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.frequency = 0.01;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateBoulders/thresholdNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<Voronoi> centerVoronoi = []() {
+		const Holder<Voronoi> centerVoronoi = []() {
 			VoronoiCreateConfig cfg;
 			cfg.cellSize = 150;
 			cfg.pointsPerCell = 2;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateBoulders/centerVoronoi");
 			return newVoronoi(cfg);
 		}();
-		static const Holder<NoiseFunction> sizeNoise = []() {
+		const Holder<NoiseFunction> sizeNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.frequency = 0.3;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateBoulders/sizeNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> hueNoise = []() {
+		const Holder<NoiseFunction> hueNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.frequency = 0.4;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateBoulders/hueNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> valueNoise = []() {
+		const Holder<NoiseFunction> valueNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.frequency = 0.8;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateBoulders/valueNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> scratchesNoise = []() {
+		const Holder<NoiseFunction> scratchesNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.frequency = 2;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateBoulders/scratchesNoise");
 			return newNoiseFunction(cfg);
 		}();
 
-		if (thresholdNoise->evaluate(tile.position) < 0.15)
-			return;
-
-		const auto centers = centerVoronoi->evaluate(tile.position, tile.normal);
-		vec3 center = centers.points[0];
-
-		real dist = distance(center, tile.position);
-		real size = sizeNoise->evaluate(tile.position) * 0.5 + 0.5;
-		size = smootherstep(smootherstep(saturate(size))) * 2 + 0.5;
-
-		real bf = rangeMask(size - dist, 0, 0.1);
-		if (bf < 1e-7)
-			return;
+		bool present(const Tile &tile) const
+		{
+			return thresholdNoise->evaluate(tile.position) >= 0.15;
+		}
 
-		real hueShift = hueNoise->evaluate(tile.position) * 0.07;
-		real valueShift = valueNoise->evaluate(tile.position) * 0.15;
-		vec3 color = colorRgbToHsv(vec3(0.6));
-		color[0] = (color[0] + hueShift + 1) % 1;
-		color[2] = saturate(color[2] + valueShift);
-		color = colorHsvToRgb(color);
-		real roughness = scratchesNoise->evaluate(tile.position) * 0.1 + 0.6;
-		real metallic = 0;
-		real height = 1 - sqr(dist / size) * 0.5;
-
-		tile.albedo = interpolate(tile.albedo, color, bf);
-		tile.roughness = interpolate(tile.roughness, roughness, bf);
-		tile.metallic = interpolate(tile.metallic, metallic, bf);
-		tile.height = interpolate(tile.height, height, bf);
-	}
+		// the center is the nearest voronoi point, evaluated by the caller for the tiles where the layer is present
+		void generate(Tile &tile, const vec3 &center) const
+		{
+			real dist = distance(center, tile.position);
+			real size = sizeNoise->evaluate(tile.position) * 0.5 + 0.5;
+			size = smootherstep(smootherstep(saturate(size))) * 2 + 0.5;
+
+			real bf = rangeMask(size - dist, 0, 0.1);
+			if (bf < 1e-7)
+				return;
+
+			real hueShift = hueNoise->evaluate(tile.position) * 0.07;
+			real valueShift = valueNoise->evaluate(tile.position) * 0.15;
+			vec3 color = colorRgbToHsv(vec3(0.6));
+			color[0] = (color[0] + hueShift + 1) % 1;
+			color[2] = saturate(color[2] + valueShift);
+			color = colorHsvToRgb(color);
+			real roughness = scratchesNoise->evaluate(tile.position) * 0.1 + 0.6;
+			real metallic = 0;
+			real height = 1 - sqr(dist / size) * 0.5;
+
+			tile.albedo = interpolate(tile.albedo, color, bf);
+			tile.roughness = interpolate(tile.roughness, roughness, bf);
+			tile.metallic = interpolate(tile.metallic, metallic, bf);
+			tile.height = interpolate(tile.height, height, bf);
+		}
+	};
 
-	void generateTreeStumps(Tile &tile)
+	struct TreeStumpsLayer
 	{
-		static const Holder<NoiseFunction> thresholdNoise = []() {
+		const Holder<NoiseFunction> thresholdNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.frequency = 0.02;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateTreeStumps/thresholdNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<Voronoi> centerVoronoi = []() {
+		const Holder<Voronoi> centerVoronoi = []() {
 			VoronoiCreateConfig cfg;
 			cfg.cellSize = 40;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateTreeStumps/centerVoronoi");
 			return newVoronoi(cfg);
 		}();
-		static const Holder<NoiseFunction> sizeNoise = []() {
+		const Holder<NoiseFunction> sizeNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.frequency = 1.5;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateTreeStumps/sizeNoise");
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> hueNoise = []() {
+		const Holder<NoiseFunction> hueNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Perlin;
 			cfg.frequency = 0.2;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("generateTreeStumps/hueNoise");
 			return newNoiseFunction(cfg);
 		}();
 
-		if (tile.type == TerrainTypeEnum::SteepSlope)
-			return;
-
-		switch (tile.biome)
+		bool present(const Tile &tile) const
 		{
-		case TerrainBiomeEnum::Taiga:
-		case TerrainBiomeEnum::TemperateRainForest:
-		case TerrainBiomeEnum::TemperateSeasonalForest:
-		case TerrainBiomeEnum::TropicalRainForest:
-		case TerrainBiomeEnum::TropicalSeasonalForest:
-			break;
-		default:
-			return; // no trees here
+			if (tile.type == TerrainTypeEnum::SteepSlope)
+				return false;
+
+			switch (tile.biome)
+			{
+			case TerrainBiomeEnum::Taiga:
+			case TerrainBiomeEnum::TemperateRainForest:
+			case TerrainBiomeEnum::TemperateSeasonalForest:
+			case TerrainBiomeEnum::TropicalRainForest:
+			case TerrainBiomeEnum::TropicalSeasonalForest:
+				break;
+			default:
+				return false; // no trees here
+			}
+
+			return thresholdNoise->evaluate(tile.position) >= 0.1;
 		}
 
-		if (thresholdNoise->evaluate(tile.position) < 0.1)
-			return;
-
-		const auto centers = centerVoronoi->evaluate(tile.position, tile.normal);
-		vec3 center = centers.points[0];
-
-		real dist = distance(center, tile.position);
-		real size = sizeNoise->evaluate(tile.position) * 0.5 + 0.5;
-		size = smootherstep(saturate(size)) * 0.4 + 0.7;
-
-		real bf = rangeMask(size - dist, 0, 0.1);
-		if (bf < 1e-7)
-			return;
-
-		real hueShift = hueNoise->evaluate(tile.position) * 0.08;
-		vec3 baseColor = colorHueShift(vec3(180, 146, 88) / 255, hueShift);
-		vec3 color = interpolate(vec3(0.5), baseColor, rangeMask(size - dist, 0.2, 0.7));
-		real roughness = 0.8;
-		real metallic = 0;
-		real height = interpolate(height, 1, rangeMask(size - dist, 0, 0.3));
-
-		tile.albedo = interpolate(tile.albedo, color, bf);
-		tile.roughness = interpolate(tile.roughness, roughness, bf);
-		tile.metallic = interpolate(tile.metallic, metallic, bf);
-		tile.height = interpolate(tile.height, height, bf);
-	}
+		// the center is the nearest voronoi point, evaluated by the caller for the tiles where the layer is present
+		void generate(Tile &tile, const vec3 &center) const
+		{
+			real dist = distance(center, tile.position);
+			real size = sizeNoise->evaluate(tile.position) * 0.5 + 0.5;
+			size = smootherstep(saturate(size)) * 0.4 + 0.7;
+
+			real bf = rangeMask(size - dist, 0, 0.1);
+			if (bf < 1e-7)
+				return;
+
+			real hueShift = hueNoise->evaluate(tile.position) * 0.08;
+			vec3 baseColor = colorHueShift(vec3(180, 146, 88) / 255, hueShift);
+			vec3 color = interpolate(vec3(0.5), baseColor, rangeMask(size - dist, 0.2, 0.7));
+			real roughness = 0.8;
+			real metallic = 0;
+			real height = interpolate(height, 1, rangeMask(size - dist, 0, 0.3));
+
+			tile.albedo = interpolate(tile.albedo, color, bf);
+			tile.roughness = interpolate(tile.roughness, roughness, bf);
+			tile.metallic = interpolate(tile.metallic, metallic, bf);
+			tile.height = interpolate(tile.height, height, bf);
+		}
+	};
 
-	void generateMoss(Tile &tile)
+	struct MossLayer
 	{
-		static const uint32 seed = noiseSeed();
-		static const Holder<NoiseFunction> cracksNoise = []() {
+		const uint32 seed = noiseSeed("generateMoss/seed");
+		const uint32 poresSeed = noiseSeed("generateMoss/pores");
+		const uint32 roughnessSeed = noiseSeed("generateMoss/roughness");
+		const Holder<NoiseFunction> cracksNoise = [&]() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cellular;
 			cfg.distance = NoiseDistanceEnum::Hybrid;
@@ -762,7 +1004,7 @@ namespace
 			cfg.seed = seed;
 			return newNoiseFunction(cfg);
 		}();
-		static const Holder<NoiseFunction> hueshiftNoise = []() {
+		const Holder<NoiseFunction> hueshiftNoise = [&]() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cellular;
 			cfg.distance = NoiseDistanceEnum::Hybrid;
@@ -773,147 +1015,382 @@ namespace
 			return newNoiseFunction(cfg);
 		}();
 
-		if (tile.biome == TerrainBiomeEnum::Water)
-			return;
-
-		real bf = rangeMask(abs(tile.temperature - 22), 6, 3) * rangeMask(tile.precipitation, 200, 250) * steepnessMask(tile.slope, degs(22));
-		if (bf < 1e-7)
-			return;
-
-		real cracks = cracksNoise->evaluate(tile.position) * 0.5 + 0.5;
-		cracks = saturate(pow(cracks, 0.4));
-		bf *= cracks * 0.5 + 0.5;
-
-		real pores = saturate(pow(randomChance(), 0.4));
-		real height = interpolate(tile.height, 0.5, 0.5) + min(cracks, pores) * 0.05;
-		real hueShift = hueshiftNoise->evaluate(tile.position) * 0.07;
-		vec3 color = colorHueShift(vec3(99, 147, 65) / 255, hueShift);
-		color = interpolate(vec3(76, 61, 50) / 255, color, pores);
-		real roughness = interpolate(0.9, randomChance() * 0.2 + 0.3, min(cracks, pores));
-		real metallic = 0;
-
-		tile.albedo = interpolate(tile.albedo, color, bf);
-		tile.roughness = interpolate(tile.roughness, roughness, bf);
-		tile.metallic = interpolate(tile.metallic, metallic, bf);
-		tile.height = interpolate(tile.height, height, bf);
-	}
+		void generate(Tile &tile) const
+		{
+			if (tile.biome == TerrainBiomeEnum::Water)
+				return;
+
+			real bf = rangeMask(abs(tile.temperature - 22), 6, 3) * rangeMask(tile.precipitation, 200, 250) * steepnessMask(tile.slope, degs(22));
+			if (bf < 1e-7)
+				return;
+
+			real cracks = cracksNoise->evaluate(tile.position) * 0.5 + 0.5;
+			cracks = saturate(pow(cracks, 0.4));
+			bf *= cracks * 0.5 + 0.5;
+
+			real pores = saturate(pow(positionRandom(tile.position, poresSeed), 0.4));
+			real height = interpolate(tile.height, 0.5, 0.5) + min(cracks, pores) * 0.05;
+			real hueShift = hueshiftNoise->evaluate(tile.position) * 0.07;
+			vec3 color = colorHueShift(vec3(99, 147, 65) / 255, hueShift);
+			color = interpolate(vec3(76, 61, 50) / 255, color, pores);
+			real roughness = interpolate(0.9, positionRandom(tile.position, roughnessSeed) * 0.2 + 0.3, min(cracks, pores));
+			real metallic = 0;
+
+			tile.albedo = interpolate(tile.albedo, color, bf);
+			tile.roughness = interpolate(tile.roughness, roughness, bf);
+			tile.metallic = interpolate(tile.metallic, metallic, bf);
+			tile.height = interpolate(tile.height, height, bf);
+		}
+	};
 
-	void generateSnow(Tile &tile)
+	struct SnowLayer
 	{
-		static const Holder<NoiseFunction> thresholdNoise = []() {
+		const Holder<NoiseFunction> thresholdNoise = []() {
 			NoiseFunctionCreateConfig cfg;
 			cfg.type = NoiseTypeEnum::Cubic;
 			cfg.fractalType = NoiseFractalTypeEnum::Fbm;
 			cfg.octaves = 3;
 			cfg.frequency = 0.1;
-			cfg.seed = noiseSeed();
+			cfg.seed = noiseSeed("snowFactor/thresholdNoise");
 			return newNoiseFunction(cfg);
 		}();
+		const uint32 roughnessSeed = noiseSeed("generateSnow/roughness");
 
-		if (tile.biome == TerrainBiomeEnum::Water)
-			return;
+		// returns the snow blending factor, zero for tiles without snow
+		real factor(const Tile &tile, real &threshold) const
+		{
+			if (tile.biome == TerrainBiomeEnum::Water)
+				return 0;
+
+			real bf = rangeMask(tile.temperature, 0, -2) * rangeMask(tile.precipitation, 50, 60) * steepnessMask(tile.slope, degs(18));
+			if (bf < 1e-7)
+				return 0;
+			threshold = (thresholdNoise->evaluate(tile.position) * 0.5 + 0.5) * 0.5 + 0.7;
+			return bf * saturate(threshold);
+		}
 
-		real bf = rangeMask(tile.temperature, 0, -2) * rangeMask(tile.precipitation, 50, 60) * steepnessMask(tile.slope, degs(18));
-		if (bf < 1e-7)
-			return;
-		real factor = (thresholdNoise->evaluate(tile.position) * 0.5 + 0.5) * 0.5 + 0.7;
-		bf *= saturate(factor);
+		static void type(Tile &tile, real bf)
+		{
+			if (bf > 0.1)
+			{
+				if (tile.type != TerrainTypeEnum::SteepSlope)
+					tile.type = TerrainTypeEnum::Slow;
+			}
+		}
+
+		void generate(Tile &tile, real bf, real threshold) const
+		{
+			if (bf < 1e-7)
+				return;
 
-		vec3 color = vec3(248) / 255;
-		real roughness = randomChance() * 0.3 + 0.2;
-		real metallic = 0;
-		real height = tile.height * 0.1 + factor * 0.2 + 0.7;
+			vec3 color = vec3(248) / 255;
+			real roughness = positionRandom(tile.position, roughnessSeed) * 0.3 + 0.2;
+			real metallic = 0;
+			real height = tile.height * 0.1 + threshold * 0.2 + 0.7;
 
-		tile.albedo = interpolate(tile.albedo, color, bf);
-		tile.roughness = interpolate(tile.roughness, roughness, bf);
-		tile.metallic = interpolate(tile.metallic, metallic, bf);
-		tile.height = interpolate(tile.height, height, bf);
+			tile.albedo = interpolate(tile.albedo, color, bf);
+			tile.roughness = interpolate(tile.roughness, roughness, bf);
+			tile.metallic = interpolate(tile.metallic, metallic, bf);
+			tile.height = interpolate(tile.height, height, bf);
 
-		if (bf > 0.1)
+			type(tile, bf);
+		}
+
+		void generateType(Tile &tile) const
 		{
-			if (tile.type != TerrainTypeEnum::SteepSlope)
-				tile.type = TerrainTypeEnum::Slow;
+			real threshold;
+			type(tile, factor(tile, threshold));
 		}
+	};
+
+	constexpr real hiddenThreshold = 1e-3;
+
+	void generateFinalization(Tile &tile)
+	{
+		tile.albedo = saturate(tile.albedo);
+		tile.roughness = saturate(tile.roughness);
+		tile.metallic = saturate(tile.metallic);
+		tile.height = saturate(tile.height);
+		tile.opacity = saturate(tile.opacity);
 	}
+}
 
-	void generateLand(Tile &tile)
+namespace
+{
+	// nearest voronoi points of one layer for the tiles where the layer is present
+	struct VoronoiQueries
 	{
-		generateElevation(tile);
-		generatePrecipitation(tile);
-		generateTemperature(tile);
-		generateSlope(tile);
+		std::vector<vec3> positions, normals;
+		std::vector<VoronoiResult> results;
+		std::vector<uint32> indices; // into the results for each tile, m where the layer is not present
+
+		template<class Layer>
+		explicit VoronoiQueries(const Layer &layer, PointerRange<const Tile> tiles)
+		{
+			indices.reserve(tiles.size());
+			for (const Tile &tile : tiles)
+			{
+				if (layer.present(tile))
+				{
+					indices.push_back(numeric_cast<uint32>(positions.size()));
+					positions.push_back(tile.position);
+					normals.push_back(tile.normal);
+				}
+				else
+					indices.push_back(m);
+			}
+			results.resize(positions.size());
+			layer.centerVoronoi->evaluate(positions, normals, results);
+		}
+
+		const vec3 *center(uint32 tile) const
+		{
+			const uint32 i = indices[tile];
+			return i == m ? nullptr : &results[i].points[0];
+		}
+	};
+}
+
+struct TerrainPropertiesContext
+{
+	const TerrainContext *const context = nullptr;
+	const ElevationLayer elevation;
+	const PrecipitationLayer precipitation;
+	const TemperatureLayer temperature;
+	const ClimateGrid climate;
+	const WaterLayer water;
+	const IceLayer ice;
+	const BedrockLayer bedrock;
+	const MicaLayer mica;
+	const DirtLayer dirt;
+	const SandLayer sand;
+	const GrassLayer grass;
+	const BouldersLayer boulders;
+	const TreeStumpsLayer treeStumps;
+	const MossLayer moss;
+	const SnowLayer snow;
+
+	explicit TerrainPropertiesContext(const TerrainContext *context) : context(context), climate(context, temperature, precipitation)
+	{}
+
+	void generateClimate(Tile &tile, const real slopeElevations[4]) const
+	{
+		elevation.generate(tile);
+		const vec2 c = climate.sample(tile.position);
+		precipitation.generate(tile, c[1]);
+		temperature.generate(tile, c[0]);
+		generateSlope(tile, slopeElevations);
+#ifdef CAGE_DEBUG
+		validateSlope(context, tile);
+#endif // CAGE_DEBUG
 		generateBiome(tile);
 		generateType(tile);
-		generateBedrock(tile);
-		generateCliffs(tile);
-		generateMica(tile);
-		generateDirt(tile);
-		generateSand(tile);
-		generateGrass(tile);
-		generateBoulders(tile);
-		generateTreeStumps(tile);
+	}
+
+	// nearest voronoi centers of the layers, null where the layer is not present
+	struct LayerCenters
+	{
+		const vec3 *boulder = nullptr;
+		const vec3 *stump = nullptr;
+	};
+
+	// the layers are blended back to front, from bedrock to snow
+	// the mask of sand is known upfront, and the layers hidden under it are skipped
+	// snow is not used for culling, its height depends on the layers beneath
+	void generateLayers(Tile &tile, bool skipHidden, const LayerCenters &centers) const
+	{
+		const real sandMask = sand.mask(tile);
+		const bool belowSand = !skipHidden || 1 - sandMask > hiddenThreshold;
+
+		if (belowSand)
+		{
+			bedrock.generate(tile);
+			generateCliffs(tile);
+			mica.generate(tile);
+			dirt.generate(tile);
+		}
+		sand.generate(tile, sandMask);
+		grass.generate(tile);
+		if (centers.boulder)
+			boulders.generate(tile, *centers.boulder);
+		if (centers.stump)
+			treeStumps.generate(tile, *centers.stump);
 		// corals
 		// seaweed
-		generateMoss(tile);
+		moss.generate(tile);
 		// leaves
 		// flowers
-		generateSnow(tile);
+		real snowThreshold = 0;
+		const real snowMask = snow.factor(tile, snowThreshold);
+		snow.generate(tile, snowMask, snowThreshold);
 	}
 
-	void generateFinalization(Tile &tile)
+	// the climate of all tiles must be generated already
+	// the voronoi centers are evaluated for all tiles of the batch together
+	void generateLand(PointerRange<Tile> tiles) const
 	{
-		tile.albedo = saturate(tile.albedo);
-		tile.roughness = saturate(tile.roughness);
-		tile.metallic = saturate(tile.metallic);
-		tile.height = saturate(tile.height);
-		tile.opacity = saturate(tile.opacity);
+		const VoronoiQueries bouldersCenters(boulders, tiles);
+		const VoronoiQueries stumpsCenters(treeStumps, tiles);
+		const uint32 cnt = numeric_cast<uint32>(tiles.size());
+		for (uint32 i = 0; i < cnt; i++)
+		{
+			Tile &tile = tiles[i];
+			LayerCenters centers;
+			centers.boulder = bouldersCenters.center(i);
+			centers.stump = stumpsCenters.center(i);
+#ifdef CAGE_DEBUG
+			Tile reference = tile;
+			generateLayers(reference, false, centers);
+#endif // CAGE_DEBUG
+			generateLayers(tile, true, centers);
+#ifdef CAGE_DEBUG
+			// the hidden layers may only shine through by the threshold
+			CAGE_ASSERT(distance(tile.albedo, reference.albedo) < hiddenThreshold * 10);
+			CAGE_ASSERT(abs(tile.roughness - reference.roughness) < hiddenThreshold * 10);
+			CAGE_ASSERT(abs(tile.metallic - reference.metallic) < hiddenThreshold * 10);
+			CAGE_ASSERT(abs(tile.height - reference.height) < hiddenThreshold * 10);
+#endif // CAGE_DEBUG
+		}
+	}
+
+	void generateWater(Tile &tile) const
+	{
+		temperature.generate(tile, climate.sample(tile.position)[0]);
+		water.generate(tile);
+		ice.generate(tile);
+	}
+
+	void generateNavigation(Tile &tile, const real slopeElevations[4]) const
+	{
+		// only the properties used by the navigation mesh and doodads, the material layers are skipped
+		generateClimate(tile, slopeElevations);
+		snow.generateType(tile);
 	}
+};
+
+Holder<TerrainPropertiesContext> newTerrainPropertiesContext(const TerrainContext *context)
+{
+	return systemMemory().createHolder<TerrainPropertiesContext>(context);
 }
 
-void terrainTileLand(Tile &tile)
+namespace
 {
-	CAGE_ASSERT(isUnit(tile.normal));
-	tile.elevation = terrainSdfElevation(tile.position);
-	generateLand(tile);
-	generateFinalization(tile);
+	const TerrainPropertiesContext *propertiesContext(const TerrainContext *context)
+	{
+		CAGE_ASSERT(context);
+		const TerrainPropertiesContext *ctx = +((const TerrainContextImpl *)context)->properties;
+		CAGE_ASSERT(ctx);
+		return ctx;
+	}
+
+	// centers of all tiles first, followed by the slope samples of each tile, so that whole batch is evaluated with single dispatch
+	struct TileSamples
+	{
+		std::vector<real> xs, ys, zs, elevs;
+		uint32 count = 0;
+
+		explicit TileSamples(PointerRange<const Tile> tiles, bool slopes)
+		{
+			count = numeric_cast<uint32>(tiles.size());
+			const uint32 total = count * (slopes ? 5 : 1);
+			xs.reserve(total);
+			ys.reserve(total);
+			zs.reserve(total);
+			for (const Tile &tile : tiles)
+			{
+				CAGE_ASSERT(isUnit(tile.normal));
+				add(tile.position);
+			}
+			if (slopes)
+			{
+				for (const Tile &tile : tiles)
+				{
+					vec3 offsets[4];
+					slopeOffsets(tile, offsets);
+					for (const vec3 &o : offsets)
+						add(tile.position + o);
+				}
+			}
+			elevs.resize(total);
+		}
+
+		void add(const vec3 &p)
+		{
+			xs.push_back(p[0]);
+			ys.push_back(p[1]);
+			zs.push_back(p[2]);
+		}
+
+		const real *slope(uint32 i) const
+		{
+			CAGE_ASSERT(i < count && elevs.size() == count * 5);
+			return elevs.data() + count + i * 4;
+		}
+	};
 }
 
-void terrainTileWater(Tile &tile)
+void terrainTileLand(const TerrainContext *context, Tile &tile)
 {
-	CAGE_ASSERT(isUnit(tile.normal));
-	tile.elevation = terrainSdfElevationRaw(tile.position);
-	generateTemperature(tile);
-	generateWater(tile);
-	generateIce(tile);
-	generateFinalization(tile);
+	terrainTileLand(context, PointerRange<Tile>(&tile, &tile + 1));
 }
 
-void terrainTileNavigation(Tile &tile)
+void terrainTileWater(const TerrainContext *context, Tile &tile)
 {
-	CAGE_ASSERT(isUnit(tile.normal));
+	terrainTileWater(context, PointerRange<Tile>(&tile, &tile + 1));
+}
+
+void terrainTileNavigation(const TerrainContext *context, Tile &tile)
+{
+	terrainTileNavigation(context, PointerRange<Tile>(&tile, &tile + 1));
+}
+
+void terrainTileLand(const TerrainContext *context, PointerRange<Tile> tiles)
+{
+	TileSamples samples(tiles, true);
+	terrainSdfElevation(context, samples.xs, samples.ys, samples.zs, samples.elevs);
+	const TerrainPropertiesContext *props = propertiesContext(context);
+	const uint32 n = numeric_cast<uint32>(tiles.size());
+	for (uint32 i = 0; i < n; i++)
 	{
-		real l = terrainSdfElevation(tile.position);
-		real w = terrainSdfElevationRaw(tile.position);
-		tile.elevation = interpolate(w, l, rangeMask(l, 5, 10));
+		Tile &tile = tiles[i];
+		tile.elevation = samples.elevs[i];
+		props->generateClimate(tile, samples.slope(i));
 	}
-	generateLand(tile);
-	generateFinalization(tile);
+	props->generateLand(tiles);
+	for (Tile &tile : tiles)
+		generateFinalization(tile);
 }
 
-void terrainPreseed()
+void terrainTileWater(const TerrainContext *context, PointerRange<Tile> tiles)
 {
+	TileSamples samples(tiles, false);
+	terrainSdfElevationRaw(context, samples.xs, samples.ys, samples.zs, samples.elevs);
+	const TerrainPropertiesContext *props = propertiesContext(context);
+	const uint32 n = numeric_cast<uint32>(tiles.size());
+	for (uint32 i = 0; i < n; i++)
 	{
-		terrainSdfLand(vec3());
-		Tile tile;
-		tile.position = vec3(0, 1, 0);
-		tile.normal = vec3(0, 1, 0);
-		terrainTileLand(tile);
+		Tile &tile = tiles[i];
+		tile.elevation = samples.elevs[i];
+		props->generateWater(tile);
+		generateFinalization(tile);
 	}
+}
+
+void terrainTileNavigation(const TerrainContext *context, PointerRange<Tile> tiles)
+{
+	TileSamples samples(tiles, true);
+	terrainSdfElevation(context, samples.xs, samples.ys, samples.zs, samples.elevs);
+	const uint32 n = numeric_cast<uint32>(tiles.size());
+	std::vector<real> raws;
+	raws.resize(n);
+	terrainSdfElevationRaw(context, { samples.xs.data(), samples.xs.data() + n }, { samples.ys.data(), samples.ys.data() + n }, { samples.zs.data(), samples.zs.data() + n }, raws);
+	const TerrainPropertiesContext *props = propertiesContext(context);
+	for (uint32 i = 0; i < n; i++)
 	{
-		terrainSdfWater(vec3());
-		Tile tile;
-		tile.position = vec3(0, 1, 0);
-		tile.normal = vec3(0, 1, 0);
-		terrainTileWater(tile);
+		Tile &tile = tiles[i];
+		const real l = samples.elevs[i];
+		const real w = raws[i];
+		tile.elevation = interpolate(w, l, rangeMask(l, 5, 10));
+		props->generateNavigation(tile, samples.slope(i));
 	}
 }
@@ -0,0 +1,392 @@
+#include <cage-core/files.h>
+#include <cage-core/image.h>
+#include <cage-core/tasks.h>
+#include <cage-core/config.h>
+
+#include "generator.h"
+#include "trace.h"
+
+#include <cstring> // std::memcpy
+#include <vector>
+
+namespace
+{
+	ConfigString configTextureFormat("unnatural-planets/texture/format");
+
+	// dxgi formats used in the dx10 header
+	enum class DxgiFormatEnum : uint32
+	{
+		Bc1 = 71,
+		Bc1Srgb = 72,
+		Bc3 = 77,
+		Bc3Srgb = 78,
+		Bc4 = 80,
+		Bc5 = 83,
+	};
+
+	struct DdsHeader
+	{
+		uint32 magic = 0x20534444; // 'DDS '
+		uint32 size = 124;
+		uint32 flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // caps, height, width, pixel format, mipmap count, linear size
+		uint32 height = 0;
+		uint32 width = 0;
+		uint32 linearSize = 0;
+		uint32 depth = 0;
+		uint32 mipMapCount = 0;
+		uint32 reserved1[11] = {};
+		uint32 pfSize = 32;
+		uint32 pfFlags = 0x4; // four cc
+		uint32 pfFourCC = 0x30315844; // 'DX10'
+		uint32 pfRgbBitCount = 0;
+		uint32 pfMasks[4] = {};
+		uint32 caps = 0x1000 | 0x400000 | 0x8; // texture, mipmap, complex
+		uint32 caps2 = 0;
+		uint32 caps3 = 0;
+		uint32 caps4 = 0;
+		uint32 reserved2 = 0;
+		uint32 dxgiFormat = 0;
+		uint32 resourceDimension = 3; // texture 2D
+		uint32 miscFlag = 0;
+		uint32 arraySize = 1;
+		uint32 miscFlags2 = 0;
+	};
+	static_assert(sizeof(DdsHeader) == 4 + 124 + 20);
+
+	// single channel block, 8 interpolated values mode
+	void encodeBc4(const uint8 *values, uint8 *out)
+	{
+		uint32 lo = 255, hi = 0;
+		for (uint32 i = 0; i < 16; i++)
+		{
+			lo = min(lo, uint32(values[i]));
+			hi = max(hi, uint32(values[i]));
+		}
+		out[0] = numeric_cast<uint8>(hi);
+		out[1] = numeric_cast<uint8>(lo);
+		uint64 bits = 0;
+		if (hi > lo)
+		{
+			for (uint32 i = 0; i < 16; i++)
+			{
+				// position between lo (0) and hi (7)
+				const uint32 p = ((values[i] - lo) * 14 + (hi - lo)) / (2 * (hi - lo));
+				const uint64 index = p == 7 ? 0 : p == 0 ? 1 : 8 - p;
+				bits |= index << (i * 3);
+			}
+		}
+		for (uint32 i = 0; i < 6; i++)
+			out[2 + i] = numeric_cast<uint8>((bits >> (i * 8)) & 0xFF);
+	}
+
+	uint16 packColor(const sint32 rgb[3])
+	{
+		const uint32 r = (clamp(rgb[0], 0, 255) * 31 + 127) / 255;
+		const uint32 g = (clamp(rgb[1], 0, 255) * 63 + 127) / 255;
+		const uint32 b = (clamp(rgb[2], 0, 255) * 31 + 127) / 255;
+		return numeric_cast<uint16>((r << 11) | (g << 5) | b);
+	}
+
+	void unpackColor(uint16 c, sint32 rgb[3])
+	{
+		const uint32 r = (c >> 11) & 31;
+		const uint32 g = (c >> 5) & 63;
+		const uint32 b = c & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// four colors mode, endpoints are the extremes along the principal axis
+	void encodeBc1(const uint8 *rgba, uint32 stride, uint8 *out)
+	{
+		vec3 mean;
+		for (uint32 i = 0; i < 16; i++)
+			mean += vec3(rgba[i * stride + 0], rgba[i * stride + 1], rgba[i * stride + 2]);
+		mean /= 16;
+		real cov[6] = {};
+		vec3 lo = vec3(real::Infinity()), hi = vec3(-real::Infinity());
+		for (uint32 i = 0; i < 16; i++)
+		{
+			const vec3 c = vec3(rgba[i * stride + 0], rgba[i * stride + 1], rgba[i * stride + 2]);
+			const vec3 d = c - mean;
+			cov[0] += d[0] * d[0];
+			cov[1] += d[0] * d[1];
+			cov[2] += d[0] * d[2];
+			cov[3] += d[1] * d[1];
+			cov[4] += d[1] * d[2];
+			cov[5] += d[2] * d[2];
+			lo = min(lo, c);
+			hi = max(hi, c);
+		}
+		vec3 axis = hi - lo;
+		for (uint32 iter = 0; iter < 4; iter++)
+		{
+			axis = vec3(cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2], cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2], cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]);
+			const real l = length(axis);
+			if (l < 1e-5)
+				break;
+			axis /= l;
+		}
+		if (length(axis) < 1e-5)
+			axis = vec3(1);
+
+		uint32 minIndex = 0, maxIndex = 0;
+		real minDot = real::Infinity(), maxDot = -real::Infinity();
+		for (uint32 i = 0; i < 16; i++)
+		{
+			const real d = dot(vec3(rgba[i * stride + 0], rgba[i * stride + 1], rgba[i * stride + 2]), axis);
+			if (d < minDot)
+			{
+				minDot = d;
+				minIndex = i;
+			}
+			if (d > maxDot)
+			{
+				maxDot = d;
+				maxIndex = i;
+			}
+		}
+
+		sint32 e[2][3];
+		for (uint32 k = 0; k < 3; k++)
+		{
+			e[0][k] = rgba[maxIndex * stride + k];
+			e[1][k] = rgba[minIndex * stride + k];
+		}
+		uint16 c0 = packColor(e[0]);
+		uint16 c1 = packColor(e[1]);
+		if (c0 < c1)
+			std::swap(c0, c1);
+		out[0] = numeric_cast<uint8>(c0 & 0xFF);
+		out[1] = numeric_cast<uint8>(c0 >> 8);
+		out[2] = numeric_cast<uint8>(c1 & 0xFF);
+		out[3] = numeric_cast<uint8>(c1 >> 8);
+		uint32 bits = 0;
+		if (c0 != c1)
+		{
+			sint32 palette[4][3];
+			unpackColor(c0, palette[0]);
+			unpackColor(c1, palette[1]);
+			for (uint32 k = 0; k < 3; k++)
+			{
+				palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+				palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+			}
+			for (uint32 i = 0; i < 16; i++)
+			{
+				uint32 best = 0;
+				sint32 bestDist = m;
+				for (uint32 j = 0; j < 4; j++)
+				{
+					sint32 dist = 0;
+					for (uint32 k = 0; k < 3; k++)
+					{
+						const sint32 d = sint32(rgba[i * stride + k]) - palette[j][k];
+						dist += d * d;
+					}
+					if (dist < bestDist)
+					{
+						bestDist = dist;
+						best = j;
+					}
+				}
+				bits |= best << (i * 2);
+			}
+		}
+		for (uint32 i = 0; i < 4; i++)
+			out[4 + i] = numeric_cast<uint8>((bits >> (i * 8)) & 0xFF);
+	}
+
+	struct DdsEncoder
+	{
+		struct Level
+		{
+			std::vector<uint8> pixels;
+			uint32 width = 0;
+			uint32 height = 0;
+			uint32 offset = 0; // in the output blocks
+		};
+
+		std::vector<Level> levels;
+		std::vector<uint8> blocks;
+		const uint32 channels = 0;
+		const DxgiFormatEnum format = DxgiFormatEnum::Bc1;
+		const uint32 blockSize = 0;
+		uint32 currentLevel = 0;
+
+		// normal maps keep only x and y in two channels, the z is reconstructed when sampling
+		static DxgiFormatEnum chooseFormat(const Image *image, TextureUsageEnum usage)
+		{
+			CAGE_ASSERT(usage != TextureUsageEnum::Height); // dds requires normal maps, see the configuration
+			if (usage == TextureUsageEnum::Normal)
+				return DxgiFormatEnum::Bc5;
+			const bool srgb = usage == TextureUsageEnum::Albedo;
+			switch (image->channels())
+			{
+				case 1: return DxgiFormatEnum::Bc4;
+				case 2: return DxgiFormatEnum::Bc5;
+				case 3: return srgb ? DxgiFormatEnum::Bc1Srgb : DxgiFormatEnum::Bc1;
+				default: return srgb ? DxgiFormatEnum::Bc3Srgb : DxgiFormatEnum::Bc3;
+			}
+		}
+
+		DdsEncoder(const Image *image, TextureUsageEnum usage) : channels(image->channels()), format(chooseFormat(image, usage)), blockSize(format == DxgiFormatEnum::Bc1 || format == DxgiFormatEnum::Bc1Srgb || format == DxgiFormatEnum::Bc4 ? 8 : 16)
+		{
+			CAGE_ASSERT(image->format() == ImageFormatEnum::U8);
+			CAGE_ASSERT(channels >= 1 && channels <= 4);
+			{
+				Level l;
+				l.width = image->width();
+				l.height = image->height();
+				const auto raw = image->rawViewU8();
+				l.pixels = std::vector<uint8>(raw.begin(), raw.end());
+				levels.push_back(std::move(l));
+			}
+			// box filtered mipmaps down to a single texel
+			while (levels.back().width > 1 || levels.back().height > 1)
+			{
+				const Level &p = levels.back();
+				Level l;
+				l.width = max(p.width / 2, 1u);
+				l.height = max(p.height / 2, 1u);
+				l.pixels.resize(l.width * l.height * channels);
+				for (uint32 y = 0; y < l.height; y++)
+				{
+					for (uint32 x = 0; x < l.width; x++)
+					{
+						const uint32 x0 = min(x * 2, p.width - 1), x1 = min(x * 2 + 1, p.width - 1);
+						const uint32 y0 = min(y * 2, p.height - 1), y1 = min(y * 2 + 1, p.height - 1);
+						for (uint32 c = 0; c < channels; c++)
+						{
+							const uint32 s = p.pixels[(y0 * p.width + x0) * channels + c] + p.pixels[(y0 * p.width + x1) * channels + c] + p.pixels[(y1 * p.width + x0) * channels + c] + p.pixels[(y1 * p.width + x1) * channels + c];
+							l.pixels[(y * l.width + x) * channels + c] = numeric_cast<uint8>((s + 2) / 4);
+						}
+					}
+				}
+				levels.push_back(std::move(l));
+			}
+			uint32 offset = 0;
+			for (Level &l : levels)
+			{
+				l.offset = offset;
+				offset += blocksX(l) * blocksY(l) * blockSize;
+			}
+			blocks.resize(offset);
+		}
+
+		static uint32 blocksX(const Level &l)
+		{
+			return (l.width + 3) / 4;
+		}
+
+		static uint32 blocksY(const Level &l)
+		{
+			return (l.height + 3) / 4;
+		}
+
+		void blockRowEntry(uint32 by)
+		{
+			const Level &l = levels[currentLevel];
+			const uint32 bx = blocksX(l);
+			for (uint32 x = 0; x < bx; x++)
+			{
+				// texels outside of the image repeat the edge
+				uint8 texels[16 * 4];
+				for (uint32 j = 0; j < 4; j++)
+				{
+					const uint32 py = min(by * 4 + j, l.height - 1);
+					for (uint32 i = 0; i < 4; i++)
+					{
+						const uint32 px = min(x * 4 + i, l.width - 1);
+						for (uint32 c = 0; c < channels; c++)
+							texels[(j * 4 + i) * channels + c] = l.pixels[(py * l.width + px) * channels + c];
+					}
+				}
+				uint8 *out = blocks.data() + l.offset + (by * bx + x) * blockSize;
+				switch (format)
+				{
+					case DxgiFormatEnum::Bc4:
+					{
+						uint8 r[16];
+						for (uint32 i = 0; i < 16; i++)
+							r[i] = texels[i * channels + 0];
+						encodeBc4(r, out);
+					} break;
+					case DxgiFormatEnum::Bc5:
+					{
+						CAGE_ASSERT(channels >= 2);
+						uint8 r[16], g[16];
+						for (uint32 i = 0; i < 16; i++)
+						{
+							r[i] = texels[i * channels + 0];
+							g[i] = texels[i * channels + 1];
+						}
+						encodeBc4(r, out);
+						encodeBc4(g, out + 8);
+					} break;
+					case DxgiFormatEnum::Bc1:
+					case DxgiFormatEnum::Bc1Srgb:
+						encodeBc1(texels, channels, out);
+						break;
+					case DxgiFormatEnum::Bc3:
+					case DxgiFormatEnum::Bc3Srgb:
+					{
+						uint8 a[16];
+						for (uint32 i = 0; i < 16; i++)
+							a[i] = texels[i * 4 + 3];
+						encodeBc4(a, out);
+						encodeBc1(texels, 4, out + 8);
+					} break;
+				}
+			}
+		}
+
+		std::vector<char> encode()
+		{
+			for (currentLevel = 0; currentLevel < levels.size(); currentLevel++)
+				tasksRun(Delegate<void(uint32)>().bind<DdsEncoder, &DdsEncoder::blockRowEntry>(this), blocksY(levels[currentLevel]));
+
+			DdsHeader header;
+			header.width = levels[0].width;
+			header.height = levels[0].height;
+			header.linearSize = blocksX(levels[0]) * blocksY(levels[0]) * blockSize;
+			header.mipMapCount = numeric_cast<uint32>(levels.size());
+			header.dxgiFormat = (uint32)format;
+			std::vector<char> result;
+			result.resize(sizeof(DdsHeader) + blocks.size());
+			std::memcpy(result.data(), &header, sizeof(header));
+			std::memcpy(result.data() + sizeof(header), blocks.data(), blocks.size());
+			return result;
+		}
+	};
+}
+
+string textureExtension()
+{
+	return (string)configTextureFormat == "dds" ? ".dds" : ".png";
+}
+
+std::vector<char> textureEncodeDds(const Holder<Image> &image, TextureUsageEnum usage)
+{
+	TraceScope trace("dds encode");
+	DdsEncoder encoder(+image, usage);
+	return encoder.encode();
+}
+
+void textureSave(const string &path, const Holder<Image> &image, TextureUsageEnum usage)
+{
+	if (pathExtractExtension(path) == ".dds")
+	{
+		const std::vector<char> buffer = textureEncodeDds(image, usage);
+		TraceScope trace("dds export");
+		Holder<File> f = writeFile(path);
+		f->write({ buffer.data(), buffer.data() + buffer.size() });
+		f->close();
+	}
+	else
+	{
+		TraceScope trace("png export");
+		image->exportFile(path);
+	}
+}
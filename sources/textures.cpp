@@ -1,96 +1,416 @@
 #include <cage-core/image.h>
 #include <cage-core/mesh.h>
+#include <cage-core/tasks.h>
+#include <cage-core/concurrent.h> // processorsCount
+#include <cage-core/config.h>
 
 #include "terrain.h"
 #include "generator.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath> // std::sqrt
+#include <cstring> // std::memcpy
+#include <unordered_map>
+#include <vector>
 
 namespace
 {
+	ConfigBool configTextureNormalMap("unnatural-planets/texture/normalMap");
+	ConfigFloat configTextureNormalStrength("unnatural-planets/texture/normalStrength");
+
+	uint32 findRoot(std::vector<uint32> &parents, uint32 i)
+	{
+		while (parents[i] != i)
+		{
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+		return i;
+	}
+
+	// charts are separated by the unwrap padding, therefore triangles of different charts never write to the same pixels
+	// vertices are joined by index and by identical uv, each resulting component belongs to a single chart
+	std::vector<std::vector<uint32>> findCharts(const Mesh *mesh)
+	{
+		const auto uvs = mesh->uvs();
+		const auto indices = mesh->indices();
+		std::vector<uint32> parents;
+		parents.resize(uvs.size());
+		for (uint32 i = 0; i < parents.size(); i++)
+			parents[i] = i;
+		const auto &join = [&](uint32 a, uint32 b) {
+			a = findRoot(parents, a);
+			b = findRoot(parents, b);
+			if (a != b)
+				parents[max(a, b)] = min(a, b);
+		};
+		{
+			std::unordered_map<uint64, uint32> welds;
+			welds.reserve(uvs.size());
+			for (uint32 i = 0; i < uvs.size(); i++)
+			{
+				uint32 k[2];
+				std::memcpy(k, &uvs[i], sizeof(k));
+				const auto it = welds.emplace((uint64(k[0]) << 32) | k[1], i);
+				if (!it.second)
+					join(it.first->second, i);
+			}
+		}
+		for (uint32 t = 0; t < indices.size(); t += 3)
+		{
+			join(indices[t + 0], indices[t + 1]);
+			join(indices[t + 0], indices[t + 2]);
+		}
+		std::vector<std::vector<uint32>> charts; // triangle indices
+		std::unordered_map<uint32, uint32> roots;
+		for (uint32 t = 0; t < indices.size(); t += 3)
+		{
+			const auto it = roots.emplace(findRoot(parents, indices[t]), numeric_cast<uint32>(charts.size()));
+			if (it.second)
+				charts.emplace_back();
+			charts[it.first->second].push_back(t / 3);
+		}
+		return charts;
+	}
+
+	// charts are distributed into batches of similar triangle counts, largest first
+	std::vector<Holder<Mesh>> splitCharts(const Mesh *mesh)
+	{
+		std::vector<std::vector<uint32>> charts = findCharts(mesh);
+		std::sort(charts.begin(), charts.end(), [](const std::vector<uint32> &a, const std::vector<uint32> &b) { return a.size() > b.size(); });
+		const uint32 batchesCount = min(numeric_cast<uint32>(charts.size()), processorsCount() * 2);
+		std::vector<std::vector<uint32>> batches; // triangle indices
+		batches.resize(batchesCount);
+		for (const auto &chart : charts)
+		{
+			auto &b = *std::min_element(batches.begin(), batches.end(), [](const std::vector<uint32> &a, const std::vector<uint32> &b) { return a.size() < b.size(); });
+			b.insert(b.end(), chart.begin(), chart.end());
+		}
+
+		const auto positions = mesh->positions();
+		const auto normals = mesh->normals();
+		const auto uvs = mesh->uvs();
+		const auto indices = mesh->indices();
+		std::vector<Holder<Mesh>> result;
+		result.reserve(batches.size());
+		std::vector<uint32> remap;
+		remap.resize(positions.size(), m);
+		for (const auto &b : batches)
+		{
+			std::vector<vec3> ps, ns;
+			std::vector<vec2> us;
+			std::vector<uint32> is;
+			is.reserve(b.size() * 3);
+			for (uint32 t : b)
+			{
+				for (uint32 j = 0; j < 3; j++)
+				{
+					const uint32 i = indices[t * 3 + j];
+					if (remap[i] == m)
+					{
+						remap[i] = numeric_cast<uint32>(ps.size());
+						ps.push_back(positions[i]);
+						ns.push_back(normals[i]);
+						us.push_back(uvs[i]);
+					}
+					is.push_back(remap[i]);
+				}
+			}
+			for (uint32 t : b)
+				for (uint32 j = 0; j < 3; j++)
+					remap[indices[t * 3 + j]] = m;
+			Holder<Mesh> msh = newMesh();
+			msh->positions(ps);
+			msh->normals(ns);
+			msh->uvs(us);
+			msh->indices(is);
+			result.push_back(std::move(msh));
+		}
+		return result;
+	}
+
+	// quantized texels, rows are stored top to bottom, as in the image files
+	struct Texels
+	{
+		std::vector<uint8> data;
+		uint32 width = 0;
+		uint32 height = 0;
+		uint32 channels = 0;
+
+		void initialize(uint32 w, uint32 h, uint32 c)
+		{
+			width = w;
+			height = h;
+			channels = c;
+			data.resize(w * h * c);
+		}
+
+		uint8 *texel(uint32 x, uint32 y)
+		{
+			return data.data() + ((height - 1 - y) * width + x) * channels;
+		}
+
+		void set(const ivec2 &xy, const vec4 &value)
+		{
+			uint8 *t = texel(xy[0], xy[1]);
+			for (uint32 i = 0; i < channels; i++)
+				t[i] = numeric_cast<uint8>(saturate(value[i]).value * 255 + 0.5f);
+		}
+
+		Holder<Image> image()
+		{
+			Holder<Image> img = newImage();
+			img->importRaw({ (const char *)data.data(), (const char *)(data.data() + data.size()) }, width, height, channels, ImageFormatEnum::U8);
+			data = {};
+			return img;
+		}
+	};
+
 	template<bool Water>
 	struct Generator
 	{
+		const TerrainContext *context = nullptr;
 		const Holder<Mesh> &mesh;
 		Holder<Image> &albedo;
 		Holder<Image> &special;
 		Holder<Image> &heightMap;
 		const uint32 width;
 		const uint32 height;
+		std::vector<Holder<Mesh>> batches;
+		Texels albedoTexels, specialTexels, heightTexels, normalTexels;
+		std::vector<uint8> coverage; // one byte per texel, concurrent batches never write to the same byte
+		std::vector<sint8> nearest, nearestNext; // offsets to the nearest covered texel, x and y interleaved
+		sint32 jumpStep = 0;
+		static constexpr sint32 PaddingRadius = 7;
+		static constexpr sint8 NoTexel = -128;
 
-		Generator(const Holder<Mesh> &mesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap) : mesh(mesh), width(width), height(height), albedo(albedo), special(special), heightMap(heightMap)
+		Generator(const TerrainContext *context, const Holder<Mesh> &mesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap) : context(context), mesh(mesh), width(width), height(height), albedo(albedo), special(special), heightMap(heightMap)
 		{}
 
-		void pixel(const ivec2 &xy, const ivec3 &indices, const vec3 &weights)
+		void store(const ivec2 &xy, const Tile &tile)
 		{
-			Tile tile;
-			tile.position = mesh->positionAt(indices, weights);
-			tile.normal = mesh->normalAt(indices, weights);
-			if (Water)
+			albedoTexels.set(xy, vec4(tile.albedo, Water ? tile.opacity : 0));
+			specialTexels.set(xy, vec4(tile.roughness, tile.metallic, 0, 0));
+			heightTexels.set(xy, vec4(tile.height, 0, 0, 0));
+			coverage[xy[1] * width + xy[0]] = 1;
+		}
+
+		// jump flooding finds the nearest covered texel within the padding radius for every empty texel
+		void jumpEntry(uint32 y)
+		{
+			for (uint32 x = 0; x < width; x++)
 			{
-				terrainTileWater(tile);
-				albedo->set(xy, vec4(tile.albedo, tile.opacity));
+				const uint32 index = y * width + x;
+				sint32 bestX = nearest[index * 2 + 0];
+				sint32 bestY = nearest[index * 2 + 1];
+				sint32 bestDist = bestX == NoTexel ? PaddingRadius * PaddingRadius * 2 + 1 : bestX * bestX + bestY * bestY;
+				for (sint32 j = -1; j < 2; j++)
+				{
+					for (sint32 i = -1; i < 2; i++)
+					{
+						const uint32 xx = x + i * jumpStep, yy = y + j * jumpStep;
+						if ((i == 0 && j == 0) || xx >= width || yy >= height)
+							continue;
+						const uint32 other = yy * width + xx;
+						if (nearest[other * 2 + 0] == NoTexel)
+							continue;
+						const sint32 dx = sint32(xx - x) + nearest[other * 2 + 0];
+						const sint32 dy = sint32(yy - y) + nearest[other * 2 + 1];
+						if (abs(dx) > PaddingRadius || abs(dy) > PaddingRadius)
+							continue;
+						const sint32 dist = dx * dx + dy * dy;
+						if (dist < bestDist)
+						{
+							bestX = dx;
+							bestY = dy;
+							bestDist = dist;
+						}
+					}
+				}
+				nearestNext[index * 2 + 0] = numeric_cast<sint8>(bestX);
+				nearestNext[index * 2 + 1] = numeric_cast<sint8>(bestY);
 			}
-			else
+		}
+
+		void fillEntry(uint32 y)
+		{
+			Texels *const texels[3] = { &albedoTexels, &specialTexels, &heightTexels };
+			for (uint32 x = 0; x < width; x++)
 			{
-				terrainTileLand(tile);
-				albedo->set(xy, tile.albedo);
+				const uint32 index = y * width + x;
+				if (coverage[index] || nearest[index * 2 + 0] == NoTexel)
+					continue;
+				const uint32 xx = x + nearest[index * 2 + 0], yy = y + nearest[index * 2 + 1];
+				for (Texels *t : texels)
+				{
+					const uint8 *src = t->texel(xx, yy);
+					uint8 *dst = t->texel(x, y);
+					for (uint32 ch = 0; ch < t->channels; ch++)
+						dst[ch] = src[ch];
+				}
 			}
-			special->set(xy, vec2(tile.roughness, tile.metallic));
-			heightMap->set(xy, tile.height);
 		}
 
-		void generate()
+		// empty texels within the radius from the charts copy the nearest covered texel
+		void padding()
 		{
-			albedo = newImage();
-			if (Water)
+			nearest.resize(width * height * 2);
+			nearestNext.resize(width * height * 2);
+			for (uint32 i = 0; i < width * height; i++)
 			{
-				albedo->initialize(width, height, 4, ImageFormatEnum::Float);
-				imageFill(+albedo, vec4::Nan());
+				const bool c = coverage[i];
+				nearest[i * 2 + 0] = c ? 0 : NoTexel;
+				nearest[i * 2 + 1] = c ? 0 : NoTexel;
 			}
-			else
+			for (sint32 step : { 4, 2, 1, 1 }) // the last extra pass fixes most of the jump flooding errors
 			{
-				albedo->initialize(width, height, 3, ImageFormatEnum::Float);
-				imageFill(+albedo, vec3::Nan());
+				jumpStep = step;
+				tasksRun(Delegate<void(uint32)>().bind<Generator, &Generator::jumpEntry>(this), height);
+				std::swap(nearest, nearestNext);
 			}
-			special = newImage();
-			special->initialize(width, height, 2, ImageFormatEnum::Float);
-			imageFill(+special, vec2::Nan());
-			heightMap = newImage();
-			heightMap->initialize(width, height, 1, ImageFormatEnum::Float);
-			imageFill(+heightMap, real::Nan());
+			nearestNext = {};
+			tasksRun(Delegate<void(uint32)>().bind<Generator, &Generator::fillEntry>(this), height);
+			nearest = {};
+		}
 
+		// sobel filter over the padded heights, in the order of the rows in the image
+		// rows go downwards, which is the negative direction of the texture v coordinate
+		void normalEntry(uint32 y)
+		{
+			const uint32 w = width;
+			const uint8 *r0 = heightTexels.data.data() + (y > 0 ? y - 1 : y) * w;
+			const uint8 *r1 = heightTexels.data.data() + y * w;
+			const uint8 *r2 = heightTexels.data.data() + (y + 1 < height ? y + 1 : y) * w;
+			std::vector<float> gx, gy;
+			gx.resize(w);
+			gy.resize(w);
+			// interior texels in simple loops that the compiler vectorizes
+			for (uint32 x = 1; x + 1 < w; x++)
+			{
+				gx[x] = float(r0[x + 1] - r0[x - 1] + 2 * (r1[x + 1] - r1[x - 1]) + r2[x + 1] - r2[x - 1]);
+				gy[x] = float(r2[x - 1] - r0[x - 1] + 2 * (r2[x] - r0[x]) + r2[x + 1] - r0[x + 1]);
+			}
+			for (uint32 x : { 0u, w - 1 })
+			{
+				const uint32 a = x > 0 ? x - 1 : x;
+				const uint32 b = x + 1 < w ? x + 1 : x;
+				gx[x] = float(r0[b] - r0[a] + 2 * (r1[b] - r1[a]) + r2[b] - r2[a]);
+				gy[x] = float(r2[a] - r0[a] + 2 * (r2[x] - r0[x]) + r2[b] - r0[b]);
+			}
+			const float strength = configTextureNormalStrength / (255 * 8.f);
+			uint8 *out = normalTexels.data.data() + y * w * 3;
+			for (uint32 x = 0; x < w; x++)
 			{
-				MeshGenerateTextureConfig cfg;
-				cfg.width = width;
-				cfg.height = height;
-				cfg.generator.bind<Generator, &Generator::pixel>(this);
-				meshGenerateTexture(+mesh, cfg);
+				const float nx = -gx[x] * strength;
+				const float ny = gy[x] * strength;
+				const float l = 1 / std::sqrt(nx * nx + ny * ny + 1);
+				out[x * 3 + 0] = uint8((nx * l * 0.5f + 0.5f) * 255 + 0.5f);
+				out[x * 3 + 1] = uint8((ny * l * 0.5f + 0.5f) * 255 + 0.5f);
+				out[x * 3 + 2] = uint8((l * 0.5f + 0.5f) * 255 + 0.5f);
 			}
+		}
+
+		static constexpr uint32 TexelsBatchSize = 256;
 
+		// the texels are collected and the terrain is evaluated for all of them together
+		struct Batch
+		{
+			Generator *generator = nullptr;
+			const Mesh *mesh = nullptr;
+			std::vector<Tile> tiles;
+			std::vector<ivec2> positions;
+
+			void pixel(const ivec2 &xy, const ivec3 &indices, const vec3 &weights)
 			{
-				imageDilation(+albedo, 7, true);
-				imageDilation(+special, 7, true);
-				imageDilation(+heightMap, 7, true);
+				Tile tile;
+				tile.position = mesh->positionAt(indices, weights);
+				tile.normal = mesh->normalAt(indices, weights);
+				tiles.push_back(tile);
+				positions.push_back(xy);
+				if (tiles.size() >= TexelsBatchSize)
+					flush();
 			}
 
-			imageConvert(+albedo, ImageFormatEnum::U8);
-			imageConvert(+special, ImageFormatEnum::U8);
-			imageConvert(+heightMap, ImageFormatEnum::U8);
+			void flush()
+			{
+				if (Water)
+					terrainTileWater(generator->context, tiles);
+				else
+					terrainTileLand(generator->context, tiles);
+				const uint32 cnt = numeric_cast<uint32>(tiles.size());
+				for (uint32 i = 0; i < cnt; i++)
+					generator->store(positions[i], tiles[i]);
+				tiles.clear();
+				positions.clear();
+			}
+		};
 
-			imageVerticalFlip(+albedo);
-			imageVerticalFlip(+special);
-			imageVerticalFlip(+heightMap);
+		// each batch writes to pixels of its own charts only
+		void batchEntry(uint32 index)
+		{
+			Batch batch;
+			batch.generator = this;
+			batch.mesh = +batches[index];
+			MeshGenerateTextureConfig cfg;
+			cfg.width = width;
+			cfg.height = height;
+			cfg.generator.bind<Batch, &Batch::pixel>(&batch);
+			batch.tiles.reserve(TexelsBatchSize);
+			batch.positions.reserve(TexelsBatchSize);
+			meshGenerateTexture(batch.mesh, cfg);
+			batch.flush();
+		}
+
+		void generate()
+		{
+			albedoTexels.initialize(width, height, Water ? 4 : 3);
+			specialTexels.initialize(width, height, 2);
+			heightTexels.initialize(width, height, 1);
+			coverage.resize(width * height);
+
+			{
+				TraceScope trace(Water ? "texture bake water" : "texture bake land");
+				batches = splitCharts(+mesh);
+				tasksRun(Delegate<void(uint32)>().bind<Generator, &Generator::batchEntry>(this), numeric_cast<uint32>(batches.size()));
+				batches.clear();
+			}
+
+			{
+				TraceScope trace("texture padding");
+				padding();
+				coverage = {};
+			}
+
+			albedo = albedoTexels.image();
+			special = specialTexels.image();
+			if (configTextureNormalMap)
+			{
+				TraceScope trace("normal map");
+				normalTexels.initialize(width, height, 3);
+				tasksRun(Delegate<void(uint32)>().bind<Generator, &Generator::normalEntry>(this), height);
+				heightTexels.data = {};
+				heightMap = normalTexels.image();
+			}
+			else
+				heightMap = heightTexels.image();
 		}
 	};
 }
 
-void generateTexturesLand(const Holder<Mesh> &renderMesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap)
+bool textureNormalMap()
+{
+	return configTextureNormalMap;
+}
+
+void generateTexturesLand(const TerrainContext *context, const Holder<Mesh> &renderMesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap)
 {
-	Generator<false> gen(renderMesh, width, height, albedo, special, heightMap);
+	Generator<false> gen(context, renderMesh, width, height, albedo, special, heightMap);
 	gen.generate();
 }
 
-void generateTexturesWater(const Holder<Mesh> &renderMesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap)
+void generateTexturesWater(const TerrainContext *context, const Holder<Mesh> &renderMesh, uint32 width, uint32 height, Holder<Image> &albedo, Holder<Image> &special, Holder<Image> &heightMap)
 {
-	Generator<true> gen(renderMesh, width, height, albedo, special, heightMap);
+	Generator<true> gen(context, renderMesh, width, height, albedo, special, heightMap);
 	gen.generate();
 }
@@ -1,9 +1,11 @@
 #include <cage-core/logger.h>
 #include <cage-core/string.h>
 #include <cage-core/mesh.h>
+#include <cage-core/tasks.h>
 
 #include "terrain.h"
 #include "generator.h"
+#include "trace.h"
 
 namespace
 {
@@ -38,6 +40,19 @@ namespace
 			maxIndex = max(maxIndex, index);
 		}
 
+		void merge(const PropertyCounters &other)
+		{
+			CAGE_ASSERT(a == other.a && b == other.b);
+			for (uint32 i = 0; i < 256; i++)
+			{
+				counts[i] += other.counts[i];
+				maxc = max(maxc, counts[i]);
+			}
+			total += other.total;
+			minIndex = min(minIndex, other.minIndex);
+			maxIndex = max(maxIndex, other.maxIndex);
+		}
+
 		void print() const
 		{
 			real meanValue = real::Nan();
@@ -57,15 +72,77 @@ namespace
 		}
 	};
 
+	struct TileCounters
+	{
+		PropertyCounters elevations = PropertyCounters(-5000, 5000);
+		PropertyCounters temperatures = PropertyCounters(-150, 150);
+		PropertyCounters precipitations = PropertyCounters(0, 2000);
+		PropertyCounters biomesCounts = PropertyCounters(0, 255);
+		PropertyCounters typesCounts = PropertyCounters(0, 255);
+
+		void insert(const Tile &tile)
+		{
+			elevations.insert(tile.elevation);
+			temperatures.insert(tile.temperature);
+			precipitations.insert(tile.precipitation);
+			biomesCounts.insert((uint8)tile.biome);
+			typesCounts.insert((uint8)tile.type);
+		}
+
+		void merge(const TileCounters &other)
+		{
+			elevations.merge(other.elevations);
+			temperatures.merge(other.temperatures);
+			precipitations.merge(other.precipitations);
+			biomesCounts.merge(other.biomesCounts);
+			typesCounts.merge(other.typesCounts);
+		}
+	};
+
+	constexpr uint32 tilesBlockSize = 1024;
+
+	struct TilesGenerator
+	{
+		const TerrainContext *context = nullptr;
+		const Holder<Mesh> &navMesh;
+		std::vector<Tile> &tiles;
+		std::vector<TileCounters> blocks;
+
+		void blockEntry(uint32 block)
+		{
+			TileCounters &counters = blocks[block];
+			const uint32 begin = block * tilesBlockSize;
+			const uint32 end = min((block + 1) * tilesBlockSize, numeric_cast<uint32>(tiles.size()));
+			for (uint32 i = begin; i < end; i++)
+			{
+				Tile &tile = tiles[i];
+				tile.position = navMesh->position(i);
+				tile.normal = navMesh->normal(i);
+			}
+			terrainTileNavigation(context, PointerRange<Tile>(tiles.data() + begin, tiles.data() + end));
+			for (uint32 i = begin; i < end; i++)
+				counters.insert(tiles[i]);
+		}
+
+		TilesGenerator(const TerrainContext *context, const Holder<Mesh> &navMesh, std::vector<Tile> &tiles) : context(context), navMesh(navMesh), tiles(tiles)
+		{
+			const uint32 cnt = navMesh->verticesCount();
+			tiles.resize(cnt);
+			blocks.resize((cnt + tilesBlockSize - 1) / tilesBlockSize);
+			tasksRun(Delegate<void(uint32)>().bind<TilesGenerator, &TilesGenerator::blockEntry>(this), numeric_cast<uint32>(blocks.size()));
+		}
+	};
+
 	bool logFilterSameThread(const detail::LoggerInfo &info)
 	{
 		return info.createThreadId == info.currentThreadId;
 	}
 }
 
-void generateTileProperties(const Holder<Mesh> &navMesh, std::vector<Tile> &tiles, const string &statsLogPath)
+void generateTileProperties(const TerrainContext *context, const Holder<Mesh> &navMesh, std::vector<Tile> &tiles, const string &statsLogPath)
 {
 	CAGE_LOG(SeverityEnum::Info, "generator", "generating tile properties");
+	TraceScope trace("tile properties");
 
 	CAGE_ASSERT(tiles.empty());
 
@@ -74,29 +151,17 @@ void generateTileProperties(const Holder<Mesh> &navMesh, std::vector<Tile> &tile
 	logger->filter.bind<&logFilterSameThread>();
 	logger->output.bind<LoggerOutputFile, &LoggerOutputFile::output>(+loggerFile);
 
-	const uint32 cnt = navMesh->verticesCount();
-	tiles.reserve(cnt);
-
-	PropertyCounters elevations(-5000, 5000);
-	PropertyCounters temperatures(-150, 150);
-	PropertyCounters precipitations(0, 2000);
-	PropertyCounters biomesCounts(0, 255);
-	PropertyCounters typesCounts(0, 255);
-
-	for (uint32 i = 0; i < cnt; i++)
+	TileCounters counters;
 	{
-		Tile tile;
-		tile.position = navMesh->position(i);
-		tile.normal = navMesh->normal(i);
-		terrainTileNavigation(tile);
-		tiles.push_back(tile);
-
-		elevations.insert(tile.elevation);
-		temperatures.insert(tile.temperature);
-		precipitations.insert(tile.precipitation);
-		biomesCounts.insert((uint8)tile.biome);
-		typesCounts.insert((uint8)tile.type);
+		TilesGenerator generator(context, navMesh, tiles);
+		for (const TileCounters &c : generator.blocks)
+			counters.merge(c);
 	}
+	const PropertyCounters &elevations = counters.elevations;
+	const PropertyCounters &temperatures = counters.temperatures;
+	const PropertyCounters &precipitations = counters.precipitations;
+	const PropertyCounters &biomesCounts = counters.biomesCounts;
+	const PropertyCounters &typesCounts = counters.typesCounts;
 
 	CAGE_LOG(SeverityEnum::Info, "tileStats", "elevations:");
 	elevations.print();
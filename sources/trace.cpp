@@ -0,0 +1,59 @@
+#include <cage-core/concurrent.h>
+#include <cage-core/files.h>
+
+#include "trace.h"
+
+#include <chrono>
+#include <vector>
+
+namespace
+{
+	struct TraceEvent
+	{
+		string name;
+		uint64 start = 0;
+		uint64 duration = 0;
+		uint64 thread = 0;
+	};
+
+	const auto traceEpoch = std::chrono::steady_clock::now();
+	Holder<Mutex> traceMutex = newMutex();
+	std::vector<TraceEvent> traceEvents;
+
+	uint64 traceTime()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+	}
+}
+
+TraceScope::TraceScope(const string &name) : name(name), start(traceTime())
+{}
+
+TraceScope::~TraceScope()
+{
+	TraceEvent e;
+	e.name = name;
+	e.start = start;
+	e.duration = traceTime() - start;
+	e.thread = currentThreadId();
+	ScopeLock lock(traceMutex);
+	traceEvents.push_back(e);
+}
+
+void traceExport(const string &path)
+{
+	CAGE_LOG(SeverityEnum::Info, "generator", stringizer() + "saving trace: " + path);
+	ScopeLock lock(traceMutex);
+	Holder<File> f = writeFile(path);
+	f->writeLine("{\"traceEvents\":[");
+	bool first = true;
+	for (const TraceEvent &e : traceEvents)
+	{
+		// each thread id becomes one track
+		f->writeLine(stringizer() + (first ? "" : ",") + "{\"name\":\"" + e.name + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + e.thread + ",\"ts\":" + e.start + ",\"dur\":" + e.duration + "}");
+		first = false;
+	}
+	f->writeLine("],\"displayTimeUnit\":\"ms\"}");
+	f->close();
+	traceEvents.clear();
+}
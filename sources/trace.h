@@ -0,0 +1,22 @@
+#ifndef trace_h_k3w8fn2q
+#define trace_h_k3w8fn2q
+
+#include <cage-core/core.h>
+
+using namespace cage;
+
+// measures the duration of the enclosing scope and records it for the chrome trace
+struct TraceScope : private Immovable
+{
+	explicit TraceScope(const string &name);
+	~TraceScope();
+
+private:
+	string name;
+	uint64 start = 0;
+};
+
+// writes all recorded scopes in chrome trace event format (chrome://tracing, perfetto) and starts over
+void traceExport(const string &path);
+
+#endif
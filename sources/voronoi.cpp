@@ -1,15 +1,103 @@
 #include <cage-core/geometry.h>
 
 #include "voronoi.h"
+#include "math.h"
 
 #include <algorithm> // std::sort
+#include <atomic>
+#include <chrono>
+#include <utility> // std::pair
+#include <vector>
 
-#ifdef _MSC_VER
-#include <malloc.h>
-#define ALLOCA _alloca
-#else
-#define ALLOCA __builtin_alloca
-#endif // _MSC_VER
+namespace
+{
+	struct CellOffsets
+	{
+		ivec3 offsets[27];
+
+		// center cell first, then faces, edges and corners, so that the nearest points are likely found before the farther cells are tested
+		CellOffsets()
+		{
+			uint32 i = 0;
+			for (sint32 n = 0; n < 4; n++)
+				for (sint32 z = -1; z < 2; z++)
+					for (sint32 y = -1; y < 2; y++)
+						for (sint32 x = -1; x < 2; x++)
+							if ((x != 0) + (y != 0) + (z != 0) == n)
+								offsets[i++] = ivec3(x, y, z);
+		}
+	};
+
+	const CellOffsets cellOffsets;
+
+	// conservative range of dot(t, p - position) for all points p in the cell
+	void cellInterval(const vec3 &t, const vec3 &lo, const vec3 &hi, real &a, real &b)
+	{
+		a = b = 0;
+		for (uint32 i = 0; i < 3; i++)
+		{
+			const real u = t[i] * lo[i];
+			const real v = t[i] * hi[i];
+			a += min(u, v);
+			b += max(u, v);
+		}
+	}
+
+	real intervalDistanceSquared(real a, real b)
+	{
+		if (a > 0)
+			return sqr(a);
+		if (b < 0)
+			return sqr(b);
+		return 0;
+	}
+
+	// consecutive queries (eg. neighboring pixels) mostly reuse the same cells
+	struct CachedCell
+	{
+		static constexpr uint32 MaxPoints = 4;
+		uint32 owner = 0; // zero for empty
+		ivec3 cell;
+		vec3 points[MaxPoints];
+	};
+
+	constexpr uint32 CellsCacheSize = 128;
+	thread_local CachedCell cellsCache[CellsCacheSize];
+	std::atomic<uint32> voronoiInstancesCounter;
+
+	// sorted by distance, the farthest one is replaced first
+	struct NearestPoints
+	{
+		vec3 points[VoronoiResult::MaxPoints];
+		real distances[VoronoiResult::MaxPoints];
+
+		NearestPoints()
+		{
+			for (real &d : distances)
+				d = real::Infinity();
+		}
+
+		real worst() const
+		{
+			return distances[VoronoiResult::MaxPoints - 1];
+		}
+
+		void insert(const vec3 &p, real d)
+		{
+			if (d >= worst())
+				return;
+			uint32 i = VoronoiResult::MaxPoints - 1;
+			while (i > 0 && distances[i - 1] > d)
+			{
+				points[i] = points[i - 1];
+				distances[i] = distances[i - 1];
+				i--;
+			}
+			points[i] = p;
+			distances[i] = d;
+		}
+	};
+}
 
 class VoronoiImpl : public Voronoi
 {
@@ -17,6 +105,7 @@ public:
 	const VoronoiCreateConfig cfg;
 	const ivec3 seedHashes;
 	const real frequency;
+	const uint32 instance = ++voronoiInstancesCounter; // identifies the instance in the cache, unlike the pointer, it is never reused
 
 	VoronoiImpl(const VoronoiCreateConfig &cfg) : cfg(cfg), seedHashes(hash(cfg.seed), hash(hash(cfg.seed)), hash(hash(hash(cfg.seed)))), frequency(1 / cfg.cellSize)
 	{}
@@ -33,49 +122,171 @@ public:
 		return vec3(s % 65536) / 65535;
 	}
 
-	void genCell(vec3 *&out, const ivec3 &cell)
+	void genCell(vec3 *out, const ivec3 &cell)
 	{
 		ivec3 s = mix(cell);
 		for (uint32 i = 0; i < cfg.pointsPerCell; i++)
 		{
 			s = mix(s);
-			*out++ = (genPoint(s) + vec3(cell)) * cfg.cellSize;
+			out[i] = (genPoint(s) + vec3(cell)) * cfg.cellSize;
 		}
 	}
 
+	const vec3 *cellPoints(const ivec3 &cell)
+	{
+		CAGE_ASSERT(cfg.pointsPerCell <= CachedCell::MaxPoints);
+		const uint32 index = (uint32(cell[0]) * 73856093u ^ uint32(cell[1]) * 19349663u ^ uint32(cell[2]) * 83492791u ^ instance) % CellsCacheSize;
+		CachedCell &c = cellsCache[index];
+		if (c.owner != instance || c.cell != cell)
+		{
+			c.owner = instance;
+			c.cell = cell;
+			genCell(c.points, cell);
+		}
+		return c.points;
+	}
+
+	// points of the 27 cells around one center cell, copied from the cache on demand
+	// the copies stay valid even when the cache entries are replaced by other cells of the neighborhood
+	struct Neighborhood
+	{
+		VoronoiImpl *impl = nullptr;
+		ivec3 center;
+		vec3 points[27][CachedCell::MaxPoints];
+		bool loaded[27] = {};
+
+		const vec3 *cell(uint32 index)
+		{
+			if (!loaded[index])
+			{
+				const vec3 *src = impl->cellPoints(center + cellOffsets.offsets[index]);
+				for (uint32 i = 0; i < impl->cfg.pointsPerCell; i++)
+					points[index][i] = src[i];
+				loaded[index] = true;
+			}
+			return points[index];
+		}
+	};
+
 	VoronoiResult evaluate(const vec3 &position, const vec3 &normal)
 	{
-		const uint32 totalPoints = cfg.pointsPerCell * 27;
-		vec3 *const pointsMem = (vec3 *)ALLOCA(totalPoints * sizeof(vec3));
-		
-		{ // generate all points (including neighboring cells)
-			vec3 *gen = pointsMem;
-			const ivec3 cell = ivec3(position * frequency);
-			for (sint32 z = -1; z < 2; z++)
-				for (sint32 y = -1; y < 2; y++)
-					for (sint32 x = -1; x < 2; x++)
-						genCell(gen, cell + ivec3(x, y, z));
-			CAGE_ASSERT(gen == pointsMem + totalPoints);
+		Neighborhood neighborhood;
+		neighborhood.impl = this;
+		neighborhood.center = ivec3(position * frequency);
+		return evaluate(position, normal, neighborhood);
+	}
+
+	// the queries are sorted by their center cells, so that each neighborhood is loaded once for all queries in it
+	void evaluate(PointerRange<const vec3> positions, PointerRange<const vec3> normals, PointerRange<VoronoiResult> results)
+	{
+		CAGE_ASSERT(positions.size() == normals.size() && positions.size() == results.size());
+		const uint32 cnt = numeric_cast<uint32>(positions.size());
+		std::vector<std::pair<ivec3, uint32>> order;
+		order.reserve(cnt);
+		for (uint32 i = 0; i < cnt; i++)
+			order.emplace_back(ivec3(positions[i] * frequency), i);
+		std::sort(order.begin(), order.end(), [](const std::pair<ivec3, uint32> &a, const std::pair<ivec3, uint32> &b) {
+			for (uint32 i = 0; i < 3; i++)
+				if (a.first[i] != b.first[i])
+					return a.first[i] < b.first[i];
+			return a.second < b.second;
+		});
+
+		Neighborhood neighborhood;
+		neighborhood.impl = this;
+		for (uint32 i = 0; i < cnt; i++)
+		{
+			const ivec3 center = order[i].first;
+			if (i == 0 || center != neighborhood.center)
+			{
+				neighborhood.center = center;
+				for (bool &l : neighborhood.loaded)
+					l = false;
+			}
+			const uint32 index = order[i].second;
+			results[index] = evaluate(positions[index], normals[index], neighborhood);
 		}
+	}
 
-		const PointerRange<vec3> points = { pointsMem, pointsMem + totalPoints };
+	VoronoiResult evaluate(const vec3 &position, const vec3 &normal, Neighborhood &neighborhood)
+	{
+		// the point projected into the plane is expressed in the two tangents
+		// the cells are bounded along both tangents to skip those that cannot contain any of the nearest points
+		const vec3 t1 = anyPerpendicular(normal);
+		const vec3 t2 = cross(normal, t1);
+		const ivec3 center = neighborhood.center;
+		CAGE_ASSERT(center == ivec3(position * frequency));
+		NearestPoints nearest;
 
-		{ // project all points into the plane
-			const Plane pln = Plane(position, normal);
-			for (vec3 &p : points)
-				p = closestPoint(pln, p);
+		for (uint32 index = 0; index < 27; index++)
+		{
+			const ivec3 offset = cellOffsets.offsets[index];
+			const ivec3 cell = center + offset;
+			if (offset != ivec3())
+			{
+				const vec3 lo = vec3(cell) * cfg.cellSize - position;
+				const vec3 hi = lo + cfg.cellSize;
+				real a1, b1, a2, b2;
+				cellInterval(t1, lo, hi, a1, b1);
+				cellInterval(t2, lo, hi, a2, b2);
+				if (intervalDistanceSquared(a1, b1) + intervalDistanceSquared(a2, b2) >= nearest.worst())
+					continue;
+			}
+
+			const vec3 *points = neighborhood.cell(index);
+			for (uint32 i = 0; i < cfg.pointsPerCell; i++)
+			{
+				const vec3 v = points[i] - position;
+				const real u1 = dot(v, t1);
+				const real u2 = dot(v, t2);
+				const real d = sqr(u1) + sqr(u2);
+				if (d < nearest.worst())
+					nearest.insert(position + t1 * u1 + t2 * u2, d);
+			}
 		}
 
-		{ // sort all points by distance
-			std::sort(points.begin(), points.end(), [&](const vec3 &a, const vec3 &b) {
-				return distanceSquared(a, position) < distanceSquared(b, position);
-				});
+		VoronoiResult res;
+		for (uint32 i = 0; i < VoronoiResult::MaxPoints; i++)
+			res.points[i] = nearest.points[i];
+
+#ifdef CAGE_DEBUG
+		{ // compare with all points sorted
+			const VoronoiResult ref = evaluateSorted(position, normal);
+			for (uint32 i = 0; i < VoronoiResult::MaxPoints; i++)
+				CAGE_ASSERT(abs(distance(res.points[i], position) - distance(ref.points[i], position)) < cfg.cellSize * 1e-4);
 		}
+#endif // CAGE_DEBUG
+
+		return res;
+	}
 
+	// all points of all 27 cells projected into the plane and sorted, without the cache
+	// slow, used for validation and as the baseline in the benchmark
+	VoronoiResult evaluateSorted(const vec3 &position, const vec3 &normal)
+	{
+		struct Candidate
+		{
+			vec3 point;
+			real distance;
+		};
+		std::vector<Candidate> all;
+		all.reserve(27 * cfg.pointsPerCell);
+		const Plane pln = Plane(position, normal);
+		const ivec3 center = ivec3(position * frequency);
+		for (const ivec3 &offset : cellOffsets.offsets)
+		{
+			vec3 points[CachedCell::MaxPoints];
+			genCell(points, center + offset);
+			for (uint32 i = 0; i < cfg.pointsPerCell; i++)
+			{
+				const vec3 p = closestPoint(pln, points[i]);
+				all.push_back({ p, distance(p, position) });
+			}
+		}
+		std::sort(all.begin(), all.end(), [](const Candidate &a, const Candidate &b) { return a.distance < b.distance; });
 		VoronoiResult res;
-		CAGE_ASSERT(VoronoiResult::MaxPoints <= points.size());
 		for (uint32 i = 0; i < VoronoiResult::MaxPoints; i++)
-			res.points[i] = points[i];
+			res.points[i] = all[i].point;
 		return res;
 	}
 };
@@ -86,7 +297,75 @@ VoronoiResult Voronoi::evaluate(const vec3 &position, const vec3 &normal)
 	return impl->evaluate(position, normal);
 }
 
+void Voronoi::evaluate(PointerRange<const vec3> positions, PointerRange<const vec3> normals, PointerRange<VoronoiResult> results)
+{
+	VoronoiImpl *impl = (VoronoiImpl *)this;
+	impl->evaluate(positions, normals, results);
+}
+
 Holder<Voronoi> newVoronoi(const VoronoiCreateConfig &cfg)
 {
+	if (cfg.pointsPerCell == 0 || cfg.pointsPerCell > CachedCell::MaxPoints)
+		CAGE_THROW_ERROR(Exception, "invalid voronoi points per cell");
 	return systemMemory().createImpl<Voronoi, VoronoiImpl>(cfg);
 }
+
+void voronoiBenchmark()
+{
+	VoronoiCreateConfig cfg;
+	cfg.cellSize = 40;
+	cfg.pointsPerCell = 2;
+	Holder<Voronoi> voronoi = newVoronoi(cfg);
+	VoronoiImpl *impl = (VoronoiImpl *)+voronoi;
+
+	// rows of neighboring samples on a sphere, similar to the texels of a chart
+	constexpr uint32 rows = 200, columns = 1000;
+	std::vector<vec3> positions, normals;
+	positions.reserve(rows * columns);
+	normals.reserve(rows * columns);
+	for (uint32 y = 0; y < rows; y++)
+	{
+		for (uint32 x = 0; x < columns; x++)
+		{
+			const vec3 n = normalize(vec3(x * 0.25 - 125, y * 0.25 - 25, 1000));
+			positions.push_back(n * 1000);
+			normals.push_back(n);
+		}
+	}
+
+	const auto measure = [&](const char *name, auto &&fnc) -> uint64 {
+		const auto start = std::chrono::steady_clock::now();
+		real sum = 0;
+		for (uint32 i = 0; i < positions.size(); i++)
+		{
+			const VoronoiResult r = fnc(positions[i], normals[i]);
+			sum += distance(r.points[0], positions[i]);
+		}
+		const uint64 duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		CAGE_LOG(SeverityEnum::Info, "benchmark", stringizer() + name + ": " + duration / 1000 + " ms, checksum: " + sum);
+		return max(duration, uint64(1));
+	};
+
+	CAGE_LOG(SeverityEnum::Info, "benchmark", stringizer() + "voronoi of " + numeric_cast<uint32>(positions.size()) + " samples, cell size: " + cfg.cellSize + ", points per cell: " + cfg.pointsPerCell);
+	const uint64 sorted = measure("full sort", [&](const vec3 &p, const vec3 &n) { return impl->evaluateSorted(p, n); });
+	const uint64 nearest = measure("nearest points", [&](const vec3 &p, const vec3 &n) { return impl->evaluate(p, n); });
+	CAGE_LOG(SeverityEnum::Info, "benchmark", stringizer() + "voronoi speedup: " + (double(sorted) / double(nearest)));
+
+	{ // batches of the same size as the texels batches
+		constexpr uint32 batchSize = 256;
+		std::vector<VoronoiResult> results;
+		results.resize(positions.size());
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32 i = 0; i < positions.size(); i += batchSize)
+		{
+			const uint32 e = min(i + batchSize, numeric_cast<uint32>(positions.size()));
+			voronoi->evaluate({ positions.data() + i, positions.data() + e }, { normals.data() + i, normals.data() + e }, { results.data() + i, results.data() + e });
+		}
+		const uint64 duration = max(uint64(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()), uint64(1));
+		real sum = 0;
+		for (uint32 i = 0; i < positions.size(); i++)
+			sum += distance(results[i].points[0], positions[i]);
+		CAGE_LOG(SeverityEnum::Info, "benchmark", stringizer() + "batches: " + duration / 1000 + " ms, checksum: " + sum);
+		CAGE_LOG(SeverityEnum::Info, "benchmark", stringizer() + "voronoi batch speedup: " + (double(sorted) / double(duration)));
+	}
+}
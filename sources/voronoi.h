@@ -15,6 +15,7 @@ class Voronoi : private Immovable
 {
 public:
 	VoronoiResult evaluate(const vec3 &position, const vec3 &normal);
+	void evaluate(PointerRange<const vec3> positions, PointerRange<const vec3> normals, PointerRange<VoronoiResult> results); // prefer for many nearby queries
 };
 
 struct VoronoiCreateConfig
@@ -25,5 +26,6 @@ struct VoronoiCreateConfig
 };
 
 Holder<Voronoi> newVoronoi(const VoronoiCreateConfig &cfg);
+void voronoiBenchmark(); // logs the timings of evaluate compared to sorting all candidates
 
 #endif